@@ -1,5 +1,8 @@
 #include "account.h"
+#include "account_cache.h"
+#include "statements.h"
 #include <random>
+#include <stdexcept>
 #include <iomanip>
 #include <sstream>
 
@@ -25,7 +28,7 @@ std::string toHex(uint64_t v) {
     return oss.str();
 }
 
-uint64_t fnv1a64(const std::string& s) {
+uint64_t fnv1a64(std::string_view s) {
     const uint64_t fnv_offset = 14695981039346656037ull;
     const uint64_t fnv_prime = 1099511628211ull;
     uint64_t hash = fnv_offset;
@@ -58,68 +61,118 @@ Account rowToAccount(const pqxx::row& r) {
     acc.username = r["username"].c_str();
     acc.pin_hash = r["pin_hash"].c_str();
     acc.salt = r["salt"].c_str();
-    acc.balance = r["balance"].as<double>();
+    acc.balance = Money::fromCents(r["balance_cents"].as<int64_t>());
     acc.failed_attempts = r["failed_attempts"].as<int>();
     acc.locked_until = r["locked_until"].as<long long>();
     return acc;
 }
 
-bool fetchAccountByUsername(pqxx::connection& conn, const std::string& username, Account& out) {
-    pqxx::work tx(conn);
-    pqxx::result res = tx.exec_params(
-        "SELECT id, username, pin_hash, salt, balance, failed_attempts, locked_until FROM accounts WHERE username = $1",
+// Single-statement reads run in autocommit mode: no BEGIN/COMMIT round-trips.
+bool fetchAccountByUsername(pqxx::connection& conn, const std::string& username, Account& out, AccountRead read) {
+    AccountCache& cache = accountCache();
+    if (read == AccountRead::Cached && cache.getByUsername(username, out)) return true;
+
+    AccountCache::Ticket ticket = cache.ticket();
+    pqxx::nontransaction tx(conn);
+    pqxx::result res = execStatement(tx, stmt::FetchAccountByUsername,
         username
     );
     if (res.empty()) return false;
     out = rowToAccount(res[0]);
+    cache.put(out, ticket);
     return true;
 }
 
-bool fetchAccountById(pqxx::connection& conn, int id, Account& out) {
-    pqxx::work tx(conn);
-    pqxx::result res = tx.exec_params(
-        "SELECT id, username, pin_hash, salt, balance, failed_attempts, locked_until FROM accounts WHERE id = $1",
+bool fetchAccountById(pqxx::connection& conn, int id, Account& out, AccountRead read) {
+    AccountCache& cache = accountCache();
+    if (read == AccountRead::Cached && cache.getById(id, out)) return true;
+
+    AccountCache::Ticket ticket = cache.ticket();
+    pqxx::nontransaction tx(conn);
+    pqxx::result res = execStatement(tx, stmt::FetchAccountById,
         id
     );
     if (res.empty()) return false;
     out = rowToAccount(res[0]);
+    cache.put(out, ticket);
     return true;
 }
 
-void updateAccountAuth(pqxx::connection& conn, const Account& acc) {
-    pqxx::work tx(conn);
-    tx.exec_params(
-        "UPDATE accounts SET failed_attempts = $1, locked_until = $2 WHERE id = $3",
-        acc.failed_attempts, acc.locked_until, acc.id
+void depositFunds(pqxx::connection& conn, int account_id, Money amount, Money& new_balance) {
+    pqxx::nontransaction tx(conn);
+    pqxx::result res = execStatement(tx, stmt::DepositFunds,
+        account_id, amount.cents()
     );
-    tx.commit();
+    if (res.empty()) throw std::runtime_error("Account not found");
+    accountCache().invalidate(account_id);
+    new_balance = Money::fromCents(res[0]["balance_cents"].as<int64_t>());
 }
 
-void updateAccountBalance(pqxx::connection& conn, int account_id, double new_balance) {
-    pqxx::work tx(conn);
-    tx.exec_params(
-        "UPDATE accounts SET balance = $1 WHERE id = $2",
-        new_balance, account_id
+bool withdrawFunds(pqxx::connection& conn, int account_id, Money amount, Money& new_balance) {
+    pqxx::nontransaction tx(conn);
+    pqxx::result res = execStatement(tx, stmt::WithdrawFunds,
+        account_id, amount.cents()
     );
-    tx.commit();
+    if (res.empty()) return false;
+    accountCache().invalidate(account_id);
+    new_balance = Money::fromCents(res[0]["balance_cents"].as<int64_t>());
+    return true;
 }
 
-int createAccount(pqxx::connection& conn, const std::string& username, const std::string& pin_hash, const std::string& salt, double initial_balance) {
+int createAccount(pqxx::connection& conn, const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance) {
     pqxx::work tx(conn);
-    pqxx::result res = tx.exec_params(
-        "INSERT INTO accounts (username, pin_hash, salt, balance) VALUES ($1, $2, $3, $4) RETURNING id",
-        username, pin_hash, salt, initial_balance
+    pqxx::result res = execStatement(tx, stmt::CreateAccount,
+        username, pin_hash, salt, initial_balance.cents()
     );
     int new_id = res[0][0].as<int>();
     tx.commit();
     return new_id;
 }
 
-void logLogin(pqxx::connection& conn, int account_id, bool success) {
-    pqxx::work tx(conn);
-    tx.exec_params(
-        "INSERT INTO login_logs (account_id, success) VALUES ($1, $2)",
-        account_id, success
-    );
-    tx.commit();
+LoginResult authenticate(pqxx::connection& conn, const std::string& username, const std::string& pin, long long now) {
+    LoginResult result;
+    if (!fetchAccountByUsername(conn, username, result.account, AccountRead::Fresh)) {
+        result.status = LoginStatus::UnknownUser;
+        return result;
+    }
+
+    Account& acc = result.account;
+    if (acc.locked_until > now) {
+        result.status = LoginStatus::Locked;
+        result.lock_remaining = acc.locked_until - now;
+        return result;
+    }
+
+    pqxx::nontransaction tx(conn);
+    if (acc.pin_hash != hashPin(pin, acc.salt)) {
+        pqxx::result res = execStatement(tx, stmt::RecordFailedLogin,
+            acc.id, kMaxFailedAttempts, now, kLockSeconds
+        );
+        accountCache().invalidate(acc.id);
+        if (res.empty()) {
+            result.status = LoginStatus::Locked;
+            result.lock_remaining = kLockSeconds;
+            return result;
+        }
+        acc.failed_attempts = res[0]["failed_attempts"].as<int>();
+        acc.locked_until = res[0]["locked_until"].as<long long>();
+        if (acc.locked_until > now) {
+            result.status = LoginStatus::LockedOut;
+        } else {
+            result.status = LoginStatus::BadPin;
+            result.attempts_left = kMaxFailedAttempts - acc.failed_attempts;
+        }
+        return result;
+    }
+
+    if (acc.failed_attempts != 0 || acc.locked_until != 0) {
+        execStatement(tx, stmt::ClearFailedLogins,
+            acc.id
+        );
+        accountCache().invalidate(acc.id);
+        acc.failed_attempts = 0;
+        acc.locked_until = 0;
+    }
+    result.status = LoginStatus::Ok;
+    return result;
 }
\ No newline at end of file
@@ -2,26 +2,57 @@
 #define ACCOUNT_H
 
 #include <string>
+#include <string_view>
 #include <pqxx/pqxx>
+#include "money.h"
+
+const int kMaxFailedAttempts = 3;
+const long long kLockSeconds = 60;
 
 struct Account {
     int id = 0;
     std::string username;
     std::string pin_hash;
     std::string salt;
-    double balance = 0.0;
+    Money balance;
     int failed_attempts = 0;
     long long locked_until = 0;
 };
 
 bool isValidUsername(const std::string& u);
 bool isValidPin(const std::string& p);
+std::string toHex(uint64_t v);
+uint64_t fnv1a64(std::string_view s);
 std::string generateSalt();
 std::string hashPin(const std::string& pin, const std::string& salt);
-bool fetchAccountByUsername(pqxx::connection& conn, const std::string& username, Account& out);
-bool fetchAccountById(pqxx::connection& conn, int id, Account& out);
-void updateAccountAuth(pqxx::connection& conn, const Account& acc);
-void updateAccountBalance(pqxx::connection& conn, int account_id, double new_balance);
-void logLogin(pqxx::connection& conn, int account_id, bool success);
+
+// Cached reads may return a row from accountCache(), which every write below
+// invalidates; Fresh always reads the database (and refreshes the cache).
+enum class AccountRead { Cached, Fresh };
+
+bool fetchAccountByUsername(pqxx::connection& conn, const std::string& username, Account& out, AccountRead read = AccountRead::Cached);
+bool fetchAccountById(pqxx::connection& conn, int id, Account& out, AccountRead read = AccountRead::Cached);
+
+// Balance mutations: one autocommit round-trip each, applied server-side so
+// concurrent sessions cannot overwrite each other's balance.
+void depositFunds(pqxx::connection& conn, int account_id, Money amount, Money& new_balance);
+bool withdrawFunds(pqxx::connection& conn, int account_id, Money amount, Money& new_balance);
+
+// Writes the InitialDeposit ledger row in the same statement when initial_balance is positive.
+int createAccount(pqxx::connection& conn, const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance);
+
+enum class LoginStatus { Ok, UnknownUser, Locked, BadPin, LockedOut };
+
+struct LoginResult {
+    LoginStatus status = LoginStatus::UnknownUser;
+    Account account;
+    long long lock_remaining = 0;   // seconds, for Locked
+    int attempts_left = 0;          // for BadPin
+};
+
+// One fresh read for the lookup (lockout state is never taken from the cache);
+// a successful login on a clean account writes nothing, a bad PIN costs one
+// atomic UPDATE. Logging is left to the caller.
+LoginResult authenticate(pqxx::connection& conn, const std::string& username, const std::string& pin, long long now);
 
 #endif // ACCOUNT_H
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "account_cache.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <pqxx/pqxx>
+
+namespace {
+
+const std::chrono::seconds kReconnectDelay(5);
+
+class InvalidationReceiver : public pqxx::notification_receiver {
+public:
+    explicit InvalidationReceiver(pqxx::connection& conn) : pqxx::notification_receiver(conn, AccountCacheListener::kChannel) {}
+
+    void operator()(const std::string& payload, int) override {
+        accountCache().countNotification();
+        try {
+            accountCache().invalidate(std::stoi(payload));
+        } catch (const std::exception&) {
+            accountCache().clear();
+        }
+    }
+};
+
+} // namespace
+
+AccountCache::AccountCache(size_t capacity) : perShard_(0) {
+    setCapacity(capacity);
+}
+
+size_t AccountCache::shardOf(const std::string& username) {
+    return static_cast<size_t>(fnv1a64(username)) % kShards;
+}
+
+void AccountCache::setCapacity(size_t capacity) {
+    perShard_.store(capacity == 0 ? 0 : (capacity + kShards - 1) / kShards, std::memory_order_relaxed);
+    clear();
+}
+
+bool AccountCache::lookup(int id, Account& out) {
+    IdShard& shard = idShards_[shardOf(id)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.byId.find(id);
+    if (it == shard.byId.end()) return false;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    out = *it->second;
+    return true;
+}
+
+bool AccountCache::getById(int id, Account& out) {
+    if (!enabled()) return false;
+    bool hit = lookup(id, out);
+    (hit ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    return hit;
+}
+
+bool AccountCache::getByUsername(const std::string& username, Account& out) {
+    if (!enabled()) return false;
+    int id = 0;
+    {
+        NameShard& shard = nameShards_[shardOf(username)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.ids.find(username);
+        if (it != shard.ids.end()) id = it->second;
+    }
+    bool hit = id != 0 && lookup(id, out) && out.username == username;
+    (hit ? hits_ : misses_).fetch_add(1, std::memory_order_relaxed);
+    return hit;
+}
+
+AccountCache::Ticket AccountCache::ticket() const {
+    Ticket t;
+    for (size_t i = 0; i < kShards; ++i) t.epochs[i] = idShards_[i].epoch.load(std::memory_order_acquire);
+    return t;
+}
+
+void AccountCache::put(const Account& acc, const Ticket& ticket) {
+    size_t limit = perShard_.load(std::memory_order_relaxed);
+    if (limit == 0) return;
+
+    std::vector<Account> evicted;
+    size_t index = shardOf(acc.id);
+    {
+        IdShard& shard = idShards_[index];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.epoch.load(std::memory_order_relaxed) != ticket.epochs[index]) {
+            stalePuts_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto it = shard.byId.find(acc.id);
+        if (it != shard.byId.end()) {
+            *it->second = acc;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        } else {
+            shard.lru.push_front(acc);
+            shard.byId[acc.id] = shard.lru.begin();
+            while (shard.lru.size() > limit) {
+                shard.byId.erase(shard.lru.back().id);
+                evicted.push_back(std::move(shard.lru.back()));
+                shard.lru.pop_back();
+            }
+        }
+    }
+    {
+        NameShard& shard = nameShards_[shardOf(acc.username)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.ids[acc.username] = acc.id;
+    }
+    // Never holding two shard locks at once keeps lock ordering trivial.
+    for (const Account& e : evicted) forgetUsername(e.username, e.id);
+    evictions_.fetch_add(evicted.size(), std::memory_order_relaxed);
+}
+
+void AccountCache::forgetUsername(const std::string& username, int id) {
+    NameShard& shard = nameShards_[shardOf(username)];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.ids.find(username);
+    if (it != shard.ids.end() && it->second == id) shard.ids.erase(it);
+}
+
+void AccountCache::invalidate(int id) {
+    if (!enabled()) return;
+    std::string username;
+    {
+        IdShard& shard = idShards_[shardOf(id)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.epoch.fetch_add(1, std::memory_order_release);
+        auto it = shard.byId.find(id);
+        if (it == shard.byId.end()) return;
+        username = std::move(it->second->username);
+        shard.lru.erase(it->second);
+        shard.byId.erase(it);
+    }
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+    forgetUsername(username, id);
+}
+
+void AccountCache::clear() {
+    for (IdShard& shard : idShards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.epoch.fetch_add(1, std::memory_order_release);
+        shard.byId.clear();
+        shard.lru.clear();
+    }
+    for (NameShard& shard : nameShards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.ids.clear();
+    }
+}
+
+AccountCacheStats AccountCache::stats() const {
+    AccountCacheStats s;
+    s.hits = hits_.load();
+    s.misses = misses_.load();
+    s.evictions = evictions_.load();
+    s.invalidations = invalidations_.load();
+    s.stale_puts = stalePuts_.load();
+    s.notifications = notifications_.load();
+    s.capacity = perShard_.load() * kShards;
+    for (const IdShard& shard : idShards_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        s.size += shard.lru.size();
+    }
+    return s;
+}
+
+AccountCache& accountCache() {
+    static AccountCache cache;
+    return cache;
+}
+
+const char* const AccountCacheListener::kChannel = "account_changes";
+
+AccountCacheListener::AccountCacheListener(const std::string& connStr) : connStr_(connStr) {
+    worker_ = std::thread(&AccountCacheListener::run, this);
+}
+
+AccountCacheListener::~AccountCacheListener() {
+    stopping_ = true;
+    wake_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+void AccountCacheListener::run() {
+    bool warned = false;
+    while (!stopping_) {
+        try {
+            pqxx::connection conn(connStr_);
+            if (!warned) {
+                pqxx::nontransaction tx(conn);
+                pqxx::result res = tx.exec("SELECT current_setting('bank.account_notify', true) IS NOT DISTINCT FROM 'on'");
+                if (!res[0][0].as<bool>()) {
+                    std::cerr << "account cache: bank.account_notify is not 'on'; other instances' writes will not reach this cache.\n";
+                    warned = true;
+                }
+            }
+            InvalidationReceiver receiver(conn);
+            accountCache().clear();
+            while (!stopping_) conn.await_notification(1, 0);
+            return;
+        } catch (const std::exception& ex) {
+            std::cerr << "account cache: listener failed: " << ex.what() << "\n";
+            accountCache().clear();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait_for(lock, kReconnectDelay, [this] { return stopping_.load(); });
+    }
+}
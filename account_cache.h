@@ -0,0 +1,120 @@
+#ifndef ACCOUNT_CACHE_H
+#define ACCOUNT_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "account.h"
+
+struct AccountCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    uint64_t stale_puts = 0;       // reads dropped because the account changed meanwhile
+    uint64_t notifications = 0;    // invalidations received over LISTEN
+    size_t size = 0;
+    size_t capacity = 0;
+};
+
+// Read-mostly cache of Account rows keyed by id, with a username index.
+// Entries are spread over kShards shards by id, each an LRU list with its own
+// lock and capacity / kShards slots; usernames map to ids in a second set of
+// shards. Only rows that exist are cached (usernames and ids never change).
+//
+// Every write path calls invalidate() after the database accepted the change.
+// A reader takes a ticket() before going to the database and hands it to
+// put(), which drops the row if its shard was invalidated in between, so a
+// slow read cannot re-insert a value older than a committed write.
+class AccountCache {
+public:
+    static const size_t kShards = 16;
+    static const size_t kDefaultCapacity = 10000;
+
+    struct Ticket {
+        std::array<uint64_t, kShards> epochs;
+    };
+
+    explicit AccountCache(size_t capacity = kDefaultCapacity);
+
+    AccountCache(const AccountCache&) = delete;
+    AccountCache& operator=(const AccountCache&) = delete;
+
+    // 0 disables the cache. Drops every entry.
+    void setCapacity(size_t capacity);
+    bool enabled() const { return perShard_.load(std::memory_order_relaxed) > 0; }
+
+    bool getById(int id, Account& out);
+    bool getByUsername(const std::string& username, Account& out);
+    Ticket ticket() const;
+    void put(const Account& acc, const Ticket& ticket);
+    void invalidate(int id);
+    void clear();
+    void countNotification() { notifications_.fetch_add(1, std::memory_order_relaxed); }
+    AccountCacheStats stats() const;
+
+private:
+    struct IdShard {
+        mutable std::mutex mutex;
+        std::list<Account> lru;    // most recently used first
+        std::unordered_map<int, std::list<Account>::iterator> byId;
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    struct NameShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, int> ids;
+    };
+
+    static size_t shardOf(int id) { return static_cast<size_t>(id) % kShards; }
+    static size_t shardOf(const std::string& username);
+    bool lookup(int id, Account& out);
+    void forgetUsername(const std::string& username, int id);
+
+    std::array<IdShard, kShards> idShards_;
+    std::array<NameShard, kShards> nameShards_;
+    std::atomic<size_t> perShard_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> evictions_{0};
+    std::atomic<uint64_t> invalidations_{0};
+    std::atomic<uint64_t> stalePuts_{0};
+    std::atomic<uint64_t> notifications_{0};
+};
+
+// The process-wide cache behind fetchAccountById/fetchAccountByUsername.
+AccountCache& accountCache();
+
+// Keeps several instances' caches coherent: LISTENs on the account_changes
+// channel on a dedicated connection and invalidates each id it receives.
+// Notifications are sent by a trigger on accounts that only fires while the
+// bank.account_notify setting is 'on' (ALTER DATABASE ... SET, so every
+// writer sends them). The cache is cleared whenever the connection is
+// (re)established, since notifications may have been missed meanwhile.
+class AccountCacheListener {
+public:
+    static const char* const kChannel;
+
+    explicit AccountCacheListener(const std::string& connStr);
+    ~AccountCacheListener();
+
+    AccountCacheListener(const AccountCacheListener&) = delete;
+    AccountCacheListener& operator=(const AccountCacheListener&) = delete;
+
+private:
+    void run();
+
+    std::string connStr_;
+    std::atomic<bool> stopping_{false};
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::thread worker_;
+};
+
+#endif // ACCOUNT_CACHE_H
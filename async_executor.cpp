@@ -0,0 +1,358 @@
+#include "async_executor.h"
+#include "metrics.h"
+#include "statements.h"
+#include <algorithm>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <libpq-fe.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace {
+std::string connectionError(pg_conn* conn) {
+    std::string msg = conn ? PQerrorMessage(conn) : "connection failed";
+    while (!msg.empty() && (msg.back() == '\n' || msg.back() == ' ')) msg.pop_back();
+    return msg;
+}
+}
+
+AsyncExecutor::AsyncExecutor(const std::string& connStr, size_t connections)
+    : connStr_(connStr), connections_(std::max<size_t>(connections, 1)) {
+    int fds[2];
+    if (::pipe(fds) != 0) throw std::runtime_error("AsyncExecutor: pipe failed");
+    wakeRead_ = fds[0];
+    wakeWrite_ = fds[1];
+    for (int fd : fds) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    // Fail at startup on a bad URL, like Database does; the rest open on first use.
+    if (!connect(connections_[0])) {
+        std::string error = connectionError(connections_[0].conn);
+        if (connections_[0].conn) PQfinish(connections_[0].conn);
+        ::close(wakeRead_);
+        ::close(wakeWrite_);
+        throw std::runtime_error("AsyncExecutor: " + error);
+    }
+    stats_.connections = connections_.size();
+    driver_ = std::thread(&AsyncExecutor::run, this);
+}
+
+AsyncExecutor::~AsyncExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    char one = 1;
+    ssize_t ignored = ::write(wakeWrite_, &one, 1);
+    (void)ignored;
+    driver_.join();
+
+    for (auto& c : connections_) {
+        if (c.conn) PQfinish(c.conn);
+    }
+    ::close(wakeRead_);
+    ::close(wakeWrite_);
+}
+
+void AsyncExecutor::submit(std::vector<AsyncStatement> statements, Callback done, std::chrono::milliseconds delay) {
+    Batch batch;
+    batch.statements = std::move(statements);
+    batch.done = std::move(done);
+    batch.submitted = Clock::now();
+    batch.due = batch.submitted + delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.submitted += 1;
+        pending_ += 1;
+        if (delay.count() > 0) {
+            delayed_.push(std::move(batch));
+        } else {
+            incoming_.push_back(std::move(batch));
+        }
+    }
+    char one = 1;
+    ssize_t ignored = ::write(wakeWrite_, &one, 1);
+    (void)ignored;
+}
+
+std::future<AsyncBatchResult> AsyncExecutor::submit(std::vector<AsyncStatement> statements) {
+    auto promise = std::make_shared<std::promise<AsyncBatchResult>>();
+    std::future<AsyncBatchResult> future = promise->get_future();
+    submit(std::move(statements), [promise](AsyncBatchResult result) {
+        promise->set_value(std::move(result));
+    });
+    return future;
+}
+
+AsyncExecutorStats AsyncExecutor::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void AsyncExecutor::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void AsyncExecutor::run() {
+    std::vector<pollfd> fds;
+    std::vector<Connection*> polled;
+    while (true) {
+        std::vector<Batch> ready;
+        int timeoutMs = -1;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (!incoming_.empty()) {
+                ready.push_back(std::move(incoming_.front()));
+                incoming_.pop_front();
+            }
+            Clock::time_point now = Clock::now();
+            while (!delayed_.empty() && delayed_.top().due <= now) {
+                ready.push_back(delayed_.top());
+                delayed_.pop();
+            }
+            if (!delayed_.empty()) {
+                auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(delayed_.top().due - now).count();
+                timeoutMs = static_cast<int>(std::max<long long>(wait, 0) + 1);
+            }
+            bool busy = !ready.empty() || !delayed_.empty() || stats_.in_flight > 0;
+            if (stopping_ && !busy) return;
+        }
+
+        for (Batch& batch : ready) {
+            // Least-loaded connection; a broken one is reopened here.
+            Connection* target = &connections_[0];
+            for (auto& c : connections_) {
+                if (c.inFlight.size() < target->inFlight.size()) target = &c;
+            }
+            send(*target, std::move(batch));
+        }
+
+        fds.clear();
+        polled.clear();
+        fds.push_back(pollfd{wakeRead_, POLLIN, 0});
+        for (auto& c : connections_) {
+            if (!c.conn || c.inFlight.empty()) continue;
+            short events = POLLIN;
+            if (c.wantWrite) events |= POLLOUT;
+            fds.push_back(pollfd{PQsocket(c.conn), events, 0});
+            polled.push_back(&c);
+        }
+
+        if (::poll(fds.data(), fds.size(), timeoutMs) < 0 && errno != EINTR) continue;
+
+        if (fds[0].revents & POLLIN) {
+            char buf[64];
+            while (::read(wakeRead_, buf, sizeof(buf)) > 0) {
+            }
+        }
+        for (size_t i = 0; i < polled.size(); ++i) {
+            Connection& c = *polled[i];
+            short revents = fds[i + 1].revents;
+            if (revents & POLLOUT) {
+                int flushed = PQflush(c.conn);
+                if (flushed < 0) {
+                    fail(c, connectionError(c.conn));
+                    continue;
+                }
+                c.wantWrite = flushed == 1;
+            }
+            if (revents & (POLLIN | POLLERR | POLLHUP)) readResults(c);
+        }
+    }
+}
+
+bool AsyncExecutor::connect(Connection& c) {
+    c.conn = PQconnectdb(connStr_.c_str());
+    if (PQstatus(c.conn) != CONNECTION_OK) return false;
+    if (preparedStatementsEnabled()) {
+        for (const char* name : statementNames()) {
+            PGresult* res = PQprepare(c.conn, name, statementSql(name).c_str(), 0, nullptr);
+            bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+            PQclear(res);
+            if (!ok) return false;
+        }
+    }
+    return PQenterPipelineMode(c.conn) == 1 && PQsetnonblocking(c.conn, 1) == 0;
+}
+
+void AsyncExecutor::send(Connection& c, Batch batch) {
+    InFlight f;
+    f.batch = std::move(batch);
+    f.result.results.resize(f.batch.statements.size());
+
+    if (!c.conn) {
+        bool ok = connect(c);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.reconnects += 1;
+        }
+        if (!ok) {
+            f.result.connection_lost = true;
+            f.result.error = connectionError(c.conn);
+            if (c.conn) PQfinish(c.conn);
+            c.conn = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stats_.in_flight += 1;
+            }
+            finish(f);
+            return;
+        }
+    }
+
+    bool sent = true;
+    bool prepared = preparedStatementsEnabled();
+    std::vector<const char*> values;
+    for (const AsyncStatement& st : f.batch.statements) {
+        values.clear();
+        for (const auto& p : st.params) values.push_back(p.c_str());
+        int n = static_cast<int>(values.size());
+        sent = prepared
+            ? PQsendQueryPrepared(c.conn, st.name, n, values.data(), nullptr, nullptr, 0) == 1
+            : PQsendQueryParams(c.conn, statementSql(st.name).c_str(), n, nullptr, values.data(), nullptr, nullptr, 0) == 1;
+        if (!sent) break;
+    }
+    if (sent) sent = PQpipelineSync(c.conn) == 1;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.in_flight += 1;
+        stats_.max_in_flight = std::max(stats_.max_in_flight, stats_.in_flight);
+    }
+    c.inFlight.push_back(std::move(f));
+    if (!sent) {
+        fail(c, connectionError(c.conn));
+        return;
+    }
+
+    int flushed = PQflush(c.conn);
+    if (flushed < 0) {
+        fail(c, connectionError(c.conn));
+        return;
+    }
+    c.wantWrite = flushed == 1;
+}
+
+// Each statement yields its results followed by a NULL; the batch ends with
+// the PGRES_PIPELINE_SYNC result. After a failure, the rest of the batch comes
+// back as PGRES_PIPELINE_ABORTED and the implicit transaction is rolled back.
+void AsyncExecutor::readResults(Connection& c) {
+    if (PQconsumeInput(c.conn) != 1) {
+        fail(c, connectionError(c.conn));
+        return;
+    }
+    while (!c.inFlight.empty() && PQisBusy(c.conn) == 0) {
+        InFlight& f = c.inFlight.front();
+        PGresult* res = PQgetResult(c.conn);
+        if (!res) {
+            if (!f.gotResult) break;
+            f.next += 1;
+            f.gotResult = false;
+            continue;
+        }
+
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_PIPELINE_SYNC) {
+            PQclear(res);
+            finish(f);
+            c.inFlight.pop_front();
+            continue;
+        }
+
+        f.gotResult = true;
+        if (f.next < f.result.results.size()) {
+            AsyncResult& out = f.result.results[f.next];
+            if (status == PGRES_TUPLES_OK || status == PGRES_COMMAND_OK) {
+                out.ok = true;
+                int rows = PQntuples(res);
+                int cols = PQnfields(res);
+                out.rows.resize(static_cast<size_t>(rows));
+                for (int r = 0; r < rows; ++r) {
+                    auto& row = out.rows[static_cast<size_t>(r)];
+                    row.reserve(static_cast<size_t>(cols));
+                    for (int k = 0; k < cols; ++k) {
+                        if (PQgetisnull(res, r, k)) {
+                            row.emplace_back();
+                        } else {
+                            row.emplace_back(std::string(PQgetvalue(res, r, k), static_cast<size_t>(PQgetlength(res, r, k))));
+                        }
+                    }
+                }
+            } else if (f.result.error.empty()) {
+                const char* state = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+                f.result.sqlstate = state ? state : "";
+                f.result.error = PQresultErrorMessage(res);
+            }
+        }
+        PQclear(res);
+    }
+    if (PQstatus(c.conn) == CONNECTION_BAD) fail(c, connectionError(c.conn));
+}
+
+void AsyncExecutor::fail(Connection& c, const std::string& error) {
+    for (InFlight& f : c.inFlight) {
+        f.result.connection_lost = true;
+        if (f.result.error.empty()) f.result.error = error;
+        finish(f);
+    }
+    c.inFlight.clear();
+    if (c.conn) PQfinish(c.conn);
+    c.conn = nullptr;
+    c.wantWrite = false;
+}
+
+void AsyncExecutor::finish(InFlight& f) {
+    AsyncBatchResult& r = f.result;
+    r.ok = !r.connection_lost && r.error.empty()
+        && std::all_of(r.results.begin(), r.results.end(), [](const AsyncResult& s) { return s.ok; });
+
+    uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - f.batch.due).count());
+    static const int metric = metricId("async_batch");
+    recordMetric(metric, ns, ns);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.in_flight -= 1;
+        if (r.ok) {
+            stats_.completed += 1;
+        } else {
+            stats_.failed += 1;
+        }
+    }
+    try {
+        f.batch.done(std::move(r));
+    } catch (...) {
+        // A throwing callback must not take the driver (and every other batch) down.
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ -= 1;
+    if (pending_ == 0) drained_.notify_all();
+}
+
+#else
+
+AsyncExecutor::AsyncExecutor(const std::string&, size_t) {
+    throw std::runtime_error("AsyncExecutor needs a POSIX platform");
+}
+
+AsyncExecutor::~AsyncExecutor() {}
+
+void AsyncExecutor::submit(std::vector<AsyncStatement>, Callback, std::chrono::milliseconds) {}
+
+std::future<AsyncBatchResult> AsyncExecutor::submit(std::vector<AsyncStatement>) {
+    return std::future<AsyncBatchResult>();
+}
+
+AsyncExecutorStats AsyncExecutor::stats() const {
+    return stats_;
+}
+
+void AsyncExecutor::waitIdle() {}
+
+#endif
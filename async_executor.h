@@ -0,0 +1,128 @@
+#ifndef ASYNC_EXECUTOR_H
+#define ASYNC_EXECUTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct pg_conn;
+
+struct AsyncStatement {
+    const char* name;                  // one of the stmt:: names
+    std::vector<std::string> params;   // text format, e.g. std::to_string(cents)
+};
+
+struct AsyncResult {
+    bool ok = false;
+    std::vector<std::vector<std::optional<std::string>>> rows;
+};
+
+struct AsyncBatchResult {
+    bool ok = false;                   // every statement ran and the batch committed
+    bool connection_lost = false;
+    std::string sqlstate;              // of the first failure, e.g. "40P01"
+    std::string error;
+    std::vector<AsyncResult> results;  // one per statement, in submission order
+};
+
+struct AsyncExecutorStats {
+    size_t connections = 0;
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    uint64_t reconnects = 0;
+    size_t in_flight = 0;
+    size_t max_in_flight = 0;          // batches outstanding at once, across all connections
+};
+
+// Runs statement batches on a few libpq connections in pipeline mode, all
+// driven by one thread. A batch is sent back-to-back and closed with a single
+// sync point, so it costs one round-trip and runs as one implicit transaction:
+// everything commits at the sync or nothing does. Batches from different
+// callers are pipelined behind each other on the same connections, so many
+// transactions can be in flight while no caller thread waits on the network.
+// Completion callbacks run on the driver thread and must not block.
+// POSIX only; the constructor throws elsewhere.
+class AsyncExecutor {
+public:
+    using Callback = std::function<void(AsyncBatchResult)>;
+
+    static const size_t kDefaultConnections = 2;
+
+    AsyncExecutor(const std::string& connStr, size_t connections = kDefaultConnections);
+    // Waits for every submitted batch to finish.
+    ~AsyncExecutor();
+
+    AsyncExecutor(const AsyncExecutor&) = delete;
+    AsyncExecutor& operator=(const AsyncExecutor&) = delete;
+
+    // delay holds the batch back first (used for retry backoff).
+    void submit(std::vector<AsyncStatement> statements, Callback done,
+                std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+    std::future<AsyncBatchResult> submit(std::vector<AsyncStatement> statements);
+    AsyncExecutorStats stats() const;
+    // Blocks until every submitted batch, including retries scheduled by its
+    // callback, has completed.
+    void waitIdle();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Batch {
+        std::vector<AsyncStatement> statements;
+        Callback done;
+        Clock::time_point due;
+        Clock::time_point submitted;
+    };
+
+    struct InFlight {
+        Batch batch;
+        AsyncBatchResult result;
+        size_t next = 0;               // statement whose results are being read
+        bool gotResult = false;
+    };
+
+    struct Connection {
+        pg_conn* conn = nullptr;
+        std::deque<InFlight> inFlight;
+        std::vector<std::string> prepared;
+        bool wantWrite = false;
+    };
+
+    struct LaterFirst {
+        bool operator()(const Batch& a, const Batch& b) const { return a.due > b.due; }
+    };
+
+    void run();
+    bool connect(Connection& c);
+    void send(Connection& c, Batch batch);
+    void readResults(Connection& c);
+    void fail(Connection& c, const std::string& error);
+    void finish(InFlight& f);
+
+    std::string connStr_;
+    std::vector<Connection> connections_;
+    int wakeRead_ = -1;
+    int wakeWrite_ = -1;
+
+    mutable std::mutex mutex_;
+    std::deque<Batch> incoming_;
+    std::priority_queue<Batch, std::vector<Batch>, LaterFirst> delayed_;
+    std::condition_variable drained_;
+    size_t pending_ = 0;               // submitted and not yet through its callback
+    bool stopping_ = false;
+    AsyncExecutorStats stats_;
+    std::thread driver_;
+};
+
+#endif // ASYNC_EXECUTOR_H
@@ -0,0 +1,187 @@
+#include "batch_statements.h"
+#include "statements.h"
+#include "transaction.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const long long kChunkIds = 1000;
+
+struct BatchAccount {
+    int id;
+    Money balance;
+};
+
+struct BatchState {
+    const StatementBatchOptions& options;
+    long long first_id;
+    long long last_id;
+    std::atomic<long long> next_chunk{0};
+    std::atomic<size_t> generated{0};
+    std::atomic<size_t> failed{0};
+    std::mutex log_mutex;
+
+    BatchState(const StatementBatchOptions& opts, long long first, long long last)
+        : options(opts), first_id(first), last_id(last) {}
+};
+
+bool storeBatch(pqxx::connection& conn, const std::vector<BatchAccount>& batch, size_t begin, size_t end, const StatementBatchOptions& options) {
+    try {
+        pqxx::work tx(conn);
+        for (size_t i = begin; i < end; ++i) {
+            storeMonthlyStatement(tx, batch[i].id, batch[i].balance, options.year, options.month);
+        }
+        tx.commit();
+        return true;
+    } catch (const pqxx::broken_connection&) {
+        throw;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Advances from_id past every committed batch, so a chunk interrupted by a
+// dropped connection can resume where it stopped.
+void processChunk(pqxx::connection& conn, BatchState& state, long long& from_id, long long to_id) {
+    std::vector<BatchAccount> accounts;
+    {
+        pqxx::nontransaction tx(conn);
+        pqxx::result res = execStatement(tx, stmt::AccountsInRange, from_id, to_id);
+        accounts.reserve(res.size());
+        for (const auto& row : res) {
+            accounts.push_back(BatchAccount{row["id"].as<int>(), Money::fromCents(row["balance_cents"].as<int64_t>())});
+        }
+    }
+
+    for (size_t begin = 0; begin < accounts.size(); begin += state.options.batch_size) {
+        size_t end = std::min(accounts.size(), begin + state.options.batch_size);
+        if (storeBatch(conn, accounts, begin, end, state.options)) {
+            state.generated += end - begin;
+            from_id = accounts[end - 1].id + 1;
+            continue;
+        }
+
+        // One bad account rolls back the whole batch: redo it one account per
+        // transaction so only the failing accounts are lost.
+        for (size_t i = begin; i < end; ++i) {
+            try {
+                pqxx::work tx(conn);
+                storeMonthlyStatement(tx, accounts[i].id, accounts[i].balance, state.options.year, state.options.month);
+                tx.commit();
+                state.generated += 1;
+            } catch (const pqxx::broken_connection&) {
+                throw;
+            } catch (const std::exception& ex) {
+                state.failed += 1;
+                std::lock_guard<std::mutex> lock(state.log_mutex);
+                std::cerr << "account " << accounts[i].id << ": " << ex.what() << "\n";
+            }
+            from_id = accounts[i].id + 1;
+        }
+    }
+}
+
+void runWorker(Database& db, BatchState& state) {
+    long long from_id = 0;
+    long long to_id = 0;
+    bool resuming = false;
+    int reconnects = 0;
+
+    while (true) {
+        Database::Lease conn = db.acquire();
+        try {
+            while (true) {
+                if (!resuming) {
+                    long long chunk = state.next_chunk.fetch_add(1);
+                    from_id = state.first_id + chunk * kChunkIds;
+                    to_id = from_id + kChunkIds;
+                    if (from_id > state.last_id) return;
+                }
+                resuming = true;
+                processChunk(*conn, state, from_id, to_id);
+                resuming = false;
+            }
+        } catch (const pqxx::broken_connection& ex) {
+            // Give the dead connection back and pick the chunk up again on a fresh one.
+            conn.markBroken();
+            if (++reconnects > 3) throw;
+            std::lock_guard<std::mutex> lock(state.log_mutex);
+            std::cerr << "worker reconnecting: " << ex.what() << "\n";
+        }
+    }
+}
+
+} // namespace
+
+StatementBatchResult runStatementBatch(Database& db, const StatementBatchOptions& options) {
+    StatementBatchResult result;
+    long long first_id = 0;
+    long long last_id = -1;
+    {
+        Database::Lease conn = db.acquire();
+        pqxx::nontransaction tx(*conn);
+        pqxx::result res = tx.exec("SELECT COALESCE(MIN(id), 0), COALESCE(MAX(id), -1), COUNT(*) FROM accounts");
+        first_id = res[0][0].as<long long>();
+        last_id = res[0][1].as<long long>();
+        result.accounts = res[0][2].as<size_t>();
+    }
+
+    std::string month = monthStartDate(options.year, options.month).substr(0, 7);
+    std::cout << "Generating " << month << " statements for " << result.accounts << " accounts with "
+              << options.workers << " workers.\n";
+
+    auto started = std::chrono::steady_clock::now();
+    BatchState state(options, first_id, last_id);
+    std::vector<std::thread> workers;
+    std::atomic<size_t> running{options.workers};
+    std::atomic<size_t> stopped{0};
+    for (size_t i = 0; i < options.workers; ++i) {
+        workers.emplace_back([&db, &state, &running, &stopped]() {
+            try {
+                runWorker(db, state);
+            } catch (const std::exception& ex) {
+                stopped += 1;
+                std::lock_guard<std::mutex> lock(state.log_mutex);
+                std::cerr << "worker stopped: " << ex.what() << "\n";
+            }
+            running -= 1;
+        });
+    }
+
+    while (running.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        size_t done = state.generated.load() + state.failed.load();
+        std::lock_guard<std::mutex> lock(state.log_mutex);
+        std::cout << "  " << done << "/" << result.accounts << " accounts, " << state.failed.load() << " failed, "
+                  << std::fixed << std::setprecision(0) << done / elapsed << " accounts/s\n";
+    }
+    for (auto& t : workers) t.join();
+
+    result.generated = state.generated.load();
+    result.failed = state.failed.load();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    // A stopped worker leaves the rest of its chunk uncounted, so failed alone
+    // would not show the statements that are missing.
+    if (stopped.load() > 0) {
+        throw std::runtime_error(std::to_string(stopped.load()) + " worker(s) stopped; only " +
+                                 std::to_string(result.generated + result.failed) + " of " +
+                                 std::to_string(result.accounts) + " accounts were processed");
+    }
+
+    std::cout << "Done: " << result.generated << " statements stored, " << result.failed << " failed in "
+              << std::fixed << std::setprecision(2) << result.seconds << " s ("
+              << std::setprecision(0) << result.generated / std::max(result.seconds, 1e-9) << " accounts/s).\n";
+    return result;
+}
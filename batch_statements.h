@@ -0,0 +1,26 @@
+#ifndef BATCH_STATEMENTS_H
+#define BATCH_STATEMENTS_H
+
+#include <cstddef>
+#include "database.h"
+
+struct StatementBatchOptions {
+    int year = 0;
+    int month = 0;
+    size_t workers = 4;
+    size_t batch_size = 100;    // accounts per committed transaction
+};
+
+struct StatementBatchResult {
+    size_t accounts = 0;
+    size_t generated = 0;
+    size_t failed = 0;
+    double seconds = 0.0;
+};
+
+// Generates the statement for every account. The account id range is cut into
+// chunks that workers claim one at a time; each worker holds its own pooled
+// connection, so the pool must have at least options.workers connections.
+StatementBatchResult runStatementBatch(Database& db, const StatementBatchOptions& options);
+
+#endif // BATCH_STATEMENTS_H
@@ -0,0 +1,336 @@
+// Microbenchmarks for the pure helpers on the request path.
+// Prints one JSON object per line: {"name", "size", "iterations", "ns_per_op", "allocs_per_op"}.
+// Usage: bench.exe [name-filter]
+#include "account.h"
+#include "account_cache.h"
+#include "local_ledger.h"
+#include "metrics.h"
+#include "output_writer.h"
+#include "utils.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<uint64_t> allocations{0};
+
+template <typename T>
+void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct Result {
+    uint64_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+};
+
+// Doubles the iteration count until one run takes at least kMinRunTime.
+Result measure(const std::function<void()>& op) {
+    const auto kMinRunTime = std::chrono::milliseconds(200);
+    uint64_t iterations = 1;
+    while (true) {
+        uint64_t allocsBefore = allocations.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) op();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t allocs = allocations.load(std::memory_order_relaxed) - allocsBefore;
+
+        if (elapsed >= kMinRunTime || iterations >= (1ull << 32)) {
+            double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            return Result{iterations, ns / static_cast<double>(iterations), static_cast<double>(allocs) / static_cast<double>(iterations)};
+        }
+        iterations *= 2;
+    }
+}
+
+std::string filter;
+
+bool selected(const std::string& name) {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+void run(const std::string& name, size_t size, const std::function<void()>& op) {
+    if (!selected(name)) return;
+    op();  // warm-up
+    Result r = measure(op);
+    std::printf("{\"name\":\"%s\",\"size\":%zu,\"iterations\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f}\n",
+                name.c_str(), size, static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.allocs_per_op);
+    std::fflush(stdout);
+}
+
+// Mostly plain text with a sprinkling of characters that need escaping.
+std::string textOfSize(size_t n) {
+    static const char pattern[] = "Payroll for \"March\" \\ bonus\tline\n";
+    std::string s;
+    s.reserve(n);
+    for (size_t i = 0; s.size() < n; ++i) {
+        s.push_back(i % 7 == 0 ? pattern[i % (sizeof(pattern) - 1)] : static_cast<char>('a' + i % 26));
+    }
+    return s;
+}
+
+// The escaping as it was before appendJsonEscaped/appendCsvEscaped: one byte
+// at a time. Kept as the reference the vectorized versions must match.
+std::string referenceEscapeJson(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+std::string referenceCsvQuoted(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        out.push_back(c);
+        if (c == '"') out.push_back('"');
+    }
+    out.push_back('"');
+    return out;
+}
+
+// Inputs covering every byte value, and every special byte at every offset
+// of a 0..99 byte string so both SIMD widths and their scalar tails are hit.
+std::vector<std::string> escapingCases() {
+    std::vector<std::string> cases;
+    std::string all;
+    for (int c = 0; c < 256; ++c) all.push_back(static_cast<char>(c));
+    cases.push_back(all);
+    for (size_t n = 0; n < 100; ++n) {
+        std::string base;
+        for (size_t i = 0; i < n; ++i) base.push_back(static_cast<char>('a' + i % 26));
+        cases.push_back(base);
+        for (char special : {'"', '\\', '\n', '\r', '\t', '\0', '\x80', '\xff'}) {
+            for (size_t at = 0; at < n; ++at) {
+                std::string s = base;
+                s[at] = special;
+                cases.push_back(s);
+            }
+        }
+    }
+    uint64_t x = 0x9e3779b97f4a7c15ull;
+    for (size_t n : {1000, 4096, 70000}) {
+        std::string s;
+        for (size_t i = 0; i < n; ++i) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            s.push_back(x % 5 == 0 ? "\"\\\n\r\t"[x / 5 % 5] : static_cast<char>(x >> 24));
+        }
+        cases.push_back(s);
+    }
+    return cases;
+}
+
+// Compares appendJsonEscaped/appendCsvEscaped, and OutputWriter with a buffer
+// small enough to split fields, byte for byte against the reference.
+bool verifyEscaping() {
+    std::vector<std::string> cases = escapingCases();
+    std::string expectJson;
+    std::string expectCsv;
+    std::string reused;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        std::string json = referenceEscapeJson(cases[i]);
+        std::string csv = referenceCsvQuoted(cases[i]);
+        reused.clear();
+        appendJsonEscaped(reused, cases[i]);
+        if (reused != json || escapeJson(cases[i]) != json) {
+            std::cerr << "escaping: JSON output differs for case " << i << "\n";
+            return false;
+        }
+        reused.assign("\"");
+        appendCsvEscaped(reused, cases[i]);
+        reused.push_back('"');
+        if (reused != csv) {
+            std::cerr << "escaping: CSV output differs for case " << i << "\n";
+            return false;
+        }
+        expectJson += json;
+        expectCsv += csv;
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "bank_bench_escape.out").string();
+    for (bool json : {true, false}) {
+        {
+            OutputWriter out(path, 7);
+            for (const std::string& c : cases) {
+                if (json) {
+                    out.writeJsonEscaped(c);
+                } else {
+                    out.writeCsvQuoted(c);
+                }
+            }
+        }
+        std::ifstream in(path, std::ios::binary);
+        std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (written != (json ? expectJson : expectCsv)) {
+            std::cerr << "escaping: OutputWriter " << (json ? "JSON" : "CSV") << " output differs\n";
+            return false;
+        }
+    }
+    std::filesystem::remove(path);
+    return true;
+}
+
+} // namespace
+
+void* operator new(std::size_t n) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1) filter = argv[1];
+    if (!verifyEscaping()) return 1;
+    const std::vector<size_t> sizes = {8, 64, 512, 4096};
+
+    for (size_t n : sizes) {
+        std::string s = textOfSize(n);
+        run("fnv1a64", n, [&] { doNotOptimize(fnv1a64(s)); });
+    }
+    run("toHex", 16, [] { doNotOptimize(toHex(0x0123456789abcdefull)); });
+    {
+        std::string salt = generateSalt();
+        for (size_t n : {4, 8}) {
+            std::string pin(n, '7');
+            run("hashPin", n, [&] { doNotOptimize(hashPin(pin, salt)); });
+        }
+    }
+    run("generateSalt", 16, [] { doNotOptimize(generateSalt()); });
+
+    for (size_t n : sizes) {
+        std::string s = textOfSize(n);
+        run("escapeJson", n, [&] { doNotOptimize(escapeJson(s)); });
+    }
+    {
+        std::string out;
+        for (size_t n : sizes) {
+            std::string s = textOfSize(n);
+            run("appendJsonEscaped", n, [&] {
+                out.clear();
+                appendJsonEscaped(out, s);
+                doNotOptimize(out);
+            });
+            run("appendCsvEscaped", n, [&] {
+                out.clear();
+                appendCsvEscaped(out, s);
+                doNotOptimize(out);
+            });
+        }
+    }
+
+    for (const char* text : {"0.05", "1234.50", "9999999999.99"}) {
+        Money m;
+        parseMoney(text, m);
+        std::string in = text;
+        run("formatMoney", in.size(), [&] { doNotOptimize(formatMoney(m)); });
+        run("parseAmount", in.size(), [&] {
+            Money out;
+            doNotOptimize(parseAmount(in, out));
+            doNotOptimize(out);
+        });
+    }
+
+    for (size_t n : sizes) {
+        std::string s = "  \t" + textOfSize(n) + " \r\n";
+        run("trim", s.size(), [&] { doNotOptimize(trim(s)); });
+    }
+
+    {
+        std::string in = "2026-09";
+        run("parseYearMonth", in.size(), [&] {
+            int year = 0;
+            int month = 0;
+            doNotOptimize(parseYearMonth(in, year, month));
+            doNotOptimize(year + month);
+        });
+    }
+
+    {
+        // A full cache at the default size; ids cycle so every shard sees traffic.
+        AccountCache cache;
+        AccountCache::Ticket ticket = cache.ticket();
+        for (int id = 1; id <= static_cast<int>(AccountCache::kDefaultCapacity); ++id) {
+            Account acc;
+            acc.id = id;
+            acc.username = "user_" + std::to_string(id);
+            cache.put(acc, ticket);
+        }
+        int next = 0;
+        run("accountCacheById", 0, [&] {
+            Account out;
+            doNotOptimize(cache.getById(next++ % 1000 + 1, out));
+        });
+        std::string name = "user_42";
+        run("accountCacheByUsername", name.size(), [&] {
+            Account out;
+            doNotOptimize(cache.getByUsername(name, out));
+        });
+    }
+
+    // Instrumentation overhead paid by every statement and menu action.
+    run("ActionTimer", 0, [] { ActionTimer timer("bench.action"); });
+    run("DbTimer", 0, [] { DbTimer timer("bench.db"); });
+
+    // Local ledger commits, without and with waiting for the disk. Snapshots
+    // taken along the way are part of the cost.
+#if !defined(_WIN32)
+    for (bool fsync : {false, true}) {
+        std::string name = fsync ? "localDepositFsync" : "localDeposit";
+        if (!selected(name) && !selected(fsync ? "localTransferFsync" : "localTransfer")) continue;
+        std::string path = (std::filesystem::temp_directory_path() / "bank_bench.jnl").string();
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".snap");
+        {
+            LocalLedgerOptions options;
+            options.fsync = fsync;
+            LocalLedger ledger(path, options);
+            ledger.createAccount("bench_a", "", "", Money::fromCents(100000000000));
+            ledger.createAccount("bench_b", "", "", Money());
+            Money balance;
+            run(name, 0, [&] { ledger.deposit(2, Money::fromCents(1), balance); });
+            run(fsync ? "localTransferFsync" : "localTransfer", 0, [&] { ledger.transfer(1, "bench_b", Money::fromCents(1), balance); });
+        }
+        std::filesystem::remove(path);
+        std::filesystem::remove(path + ".snap");
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,394 @@
+#include "client.h"
+#include "account.h"
+#include "utils.h"
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+class ServerConnection {
+public:
+    ~ServerConnection() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    bool open(const std::string& host, int port) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* found = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &found) != 0) return false;
+        for (addrinfo* ai = found; ai; ai = ai->ai_next) {
+            fd_ = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd_ < 0) continue;
+            if (::connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0) break;
+            ::close(fd_);
+            fd_ = -1;
+        }
+        freeaddrinfo(found);
+        if (fd_ < 0) return false;
+        int one = 1;
+        setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+    // Sends one request line and reads the status line of its reply.
+    bool request(const std::string& line, std::string& reply) {
+        std::string out = line + "\n";
+        size_t sent = 0;
+        while (sent < out.size()) {
+            ssize_t n = ::send(fd_, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return readLine(reply);
+    }
+
+    bool readLine(std::string& line) {
+        while (true) {
+            size_t nl = buffer_.find('\n');
+            if (nl != std::string::npos) {
+                line = buffer_.substr(0, nl);
+                buffer_.erase(0, nl + 1);
+                return true;
+            }
+            char buf[4096];
+            ssize_t n = ::recv(fd_, buf, sizeof(buf), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            buffer_.append(buf, static_cast<size_t>(n));
+        }
+    }
+
+private:
+    int fd_ = -1;
+    std::string buffer_;
+};
+
+struct ConnectionLost {};
+
+bool isOk(const std::string& reply) {
+    return reply == "OK" || reply.rfind("OK ", 0) == 0;
+}
+
+// Word i of a reply ("OK 12.50" -> word 1 is "12.50").
+std::string word(const std::string& reply, size_t i) {
+    std::istringstream in(reply);
+    std::string w;
+    for (size_t k = 0; k <= i; ++k) {
+        if (!(in >> w)) return "";
+    }
+    return w;
+}
+
+std::vector<std::string> splitTabs(const std::string& row) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = row.find('\t', start);
+        fields.push_back(row.substr(start, tab == std::string::npos ? std::string::npos : tab - start));
+        if (tab == std::string::npos) return fields;
+        start = tab + 1;
+    }
+}
+
+std::string call(ServerConnection& server, const std::string& line) {
+    std::string reply;
+    if (!server.request(line, reply)) throw ConnectionLost();
+    return reply;
+}
+
+// Reads the n rows that follow a multi-row reply.
+std::vector<std::vector<std::string>> readRows(ServerConnection& server, size_t n) {
+    std::vector<std::vector<std::string>> rows;
+    for (size_t i = 0; i < n; ++i) {
+        std::string line;
+        if (!server.readLine(line)) throw ConnectionLost();
+        rows.push_back(splitTabs(line));
+    }
+    return rows;
+}
+
+void printError(const std::string& reply) {
+    std::string code = word(reply, 1);
+    if (code == "insufficient-funds") {
+        std::cout << RED << "Insufficient funds." << RESET << std::endl;
+    } else if (code == "recipient-not-found") {
+        std::cout << "Recipient not found.\n";
+    } else if (code == "self-transfer") {
+        std::cout << "Cannot transfer to yourself. Use a different account.\n";
+    } else if (code == "contention") {
+        std::cout << RED << "Transfer could not complete due to contention. Please try again." << RESET << std::endl;
+    } else if (code == "busy" || code == "queue-full") {
+        std::cout << RED << "Server is busy. Try again shortly." << RESET << std::endl;
+    } else {
+        std::cout << RED << "Server error: " << reply << RESET << std::endl;
+    }
+}
+
+// Returns the new balance, or an empty string after printing the error.
+std::string balanceCall(ServerConnection& server, const std::string& line) {
+    std::string reply = call(server, line);
+    if (!isOk(reply)) {
+        printError(reply);
+        return "";
+    }
+    return word(reply, 1);
+}
+
+bool showHistoryPage(ServerConnection& server, const std::string& line, long long& newest, long long& oldest, bool& hasOlder, bool& hasNewer) {
+    std::string reply = call(server, line);
+    if (!isOk(reply)) {
+        printError(reply);
+        return false;
+    }
+    size_t n = std::stoul(word(reply, 1));
+    hasOlder = word(reply, 2) == "1";
+    hasNewer = word(reply, 3) == "1";
+    auto rows = readRows(server, n);
+    if (rows.empty()) {
+        std::cout << "No transactions yet.\n";
+        return true;
+    }
+    for (const auto& r : rows) {
+        if (r.size() < 6) continue;
+        std::cout << "- [" << r[1] << "] " << r[2] << " $" << r[3];
+        if (!r[4].empty()) std::cout << " (" << r[4] << ")";
+        if (!r[5].empty()) std::cout << " - " << r[5];
+        std::cout << "\n";
+    }
+    newest = std::stoll(rows.front()[0]);
+    oldest = std::stoll(rows.back()[0]);
+    return true;
+}
+
+void accountMenu(ServerConnection& server, const std::string& username, std::string balance) {
+    while (true) {
+        std::cout << "\nLogged in as: " << username << " (remote)\n";
+        std::cout << "Balance: $" << balance << "\n";
+        std::cout << "1. Deposit\n";
+        std::cout << "2. Withdraw\n";
+        std::cout << "3. Transfer (Real)\n";
+        std::cout << "4. Fake Transfer\n";
+        std::cout << "5. View History\n";
+        std::cout << "6. Export History (CSV/JSON, written on the server)\n";
+        std::cout << "7. Generate Monthly Statement (store in Neon)\n";
+        std::cout << "8. Background Jobs\n";
+        std::cout << "9. Logout\n";
+
+        std::string choice = prompt("Select an option: ");
+        if (choice == "1" || choice == "2") {
+            Money amt;
+            std::string in = prompt(choice == "1" ? "Deposit amount: " : "Withdraw amount: ");
+            if (!parseAmount(in, amt)) {
+                std::cout << RED << "Invalid amount." << RESET << std::endl;
+                continue;
+            }
+            std::string next = balanceCall(server, (choice == "1" ? "DEPOSIT " : "WITHDRAW ") + formatMoney(amt));
+            if (next.empty()) continue;
+            balance = next;
+            std::cout << GREEN << (choice == "1" ? "Deposit complete." : "Withdrawal complete.") << RESET << std::endl;
+        } else if (choice == "3") {
+            std::string toUser = prompt("Recipient username: ");
+            if (!isValidUsername(toUser)) {
+                std::cout << "Recipient not found.\n";
+                continue;
+            }
+            Money amt;
+            std::string in = prompt("Transfer amount: ");
+            if (!parseAmount(in, amt)) {
+                std::cout << RED << "Invalid amount." << RESET << std::endl;
+                continue;
+            }
+            std::string next = balanceCall(server, "TRANSFER " + toUser + " " + formatMoney(amt));
+            if (next.empty()) continue;
+            balance = next;
+            std::cout << GREEN << "Transfer complete." << RESET << std::endl;
+        } else if (choice == "4") {
+            std::string toUser = prompt("Recipient username (simulated): ");
+            Money amt;
+            std::string in = prompt("Transfer amount (simulated): ");
+            if (!parseAmount(in, amt)) {
+                std::cout << RED << "Invalid amount." << RESET << std::endl;
+                continue;
+            }
+            if (toUser.empty() || toUser.find_first_of(" \t") != std::string::npos) {
+                std::cout << "Recipient must be a single word.\n";
+                continue;
+            }
+            std::string reply = call(server, "FAKE " + toUser + " " + formatMoney(amt));
+            if (!isOk(reply)) {
+                printError(reply);
+                continue;
+            }
+            std::cout << GREEN << "Fake transfer recorded. No balances were moved." << RESET << std::endl;
+        } else if (choice == "5") {
+            long long newest = 0;
+            long long oldest = 0;
+            bool hasOlder = false;
+            bool hasNewer = false;
+            if (!showHistoryPage(server, "HISTORY", newest, oldest, hasOlder, hasNewer)) continue;
+            while (hasOlder || hasNewer) {
+                std::string nav = prompt(std::string(hasOlder ? "[n] older  " : "") +
+                                         (hasNewer ? "[p] newer  " : "") + "[Enter] back: ");
+                std::string line;
+                if (nav == "n" && hasOlder) {
+                    line = "HISTORY OLDER " + std::to_string(oldest);
+                } else if (nav == "p" && hasNewer) {
+                    line = "HISTORY NEWER " + std::to_string(newest);
+                } else {
+                    break;
+                }
+                if (!showHistoryPage(server, line, newest, oldest, hasOlder, hasNewer)) break;
+            }
+        } else if (choice == "6" || choice == "7") {
+            std::string line = "EXPORT";
+            if (choice == "7") {
+                std::string input = prompt("Statement month (YYYY-MM, Enter for current): ");
+                int year = 0;
+                int month = 0;
+                if (!input.empty() && !parseYearMonth(input, year, month)) {
+                    std::cout << "Invalid month format. Use YYYY-MM.\n";
+                    continue;
+                }
+                line = input.empty() ? "STATEMENT" : "STATEMENT " + input;
+            }
+            std::string reply = call(server, line);
+            if (!isOk(reply)) {
+                printError(reply);
+                continue;
+            }
+            beep();
+            std::cout << GREEN << (choice == "6" ? "Export" : "Statement generation") << " queued as job #" << word(reply, 1) << "." << RESET << std::endl;
+        } else if (choice == "8") {
+            std::string reply = call(server, "JOBS");
+            if (!isOk(reply)) {
+                printError(reply);
+                continue;
+            }
+            auto rows = readRows(server, std::stoul(word(reply, 1)));
+            if (rows.empty()) std::cout << "No background jobs this session.\n";
+            for (const auto& r : rows) {
+                if (r.size() < 5) continue;
+                std::cout << "- #" << r[0] << " " << r[1] << ": " << r[2];
+                if (r[2] == "done" || r[2] == "failed") std::cout << " in " << r[3] << " ms";
+                if (!r[4].empty()) std::cout << " (" << r[4] << ")";
+                std::cout << "\n";
+            }
+        } else if (choice == "9") {
+            call(server, "LOGOUT");
+            std::cout << "Logged out.\n";
+            return;
+        } else {
+            std::cout << "Invalid option.\n";
+        }
+    }
+}
+
+void mainMenu(ServerConnection& server) {
+    while (true) {
+        std::cout << "\n1. Create Account\n";
+        std::cout << "2. Login\n";
+        std::cout << "3. Exit\n";
+
+        std::string choice = prompt("Select an option: ");
+        if (choice == "1") {
+            std::string username = prompt("Choose username (3-20, letters/numbers/_/-): ");
+            if (!isValidUsername(username)) {
+                std::cout << "Invalid username.\n";
+                continue;
+            }
+            std::string pin = prompt("Choose PIN (4-8 digits): ");
+            if (!isValidPin(pin)) {
+                std::cout << "Invalid PIN.\n";
+                continue;
+            }
+            std::string line = "CREATE " + username + " " + pin;
+            std::string initial = prompt("Initial deposit (optional, press Enter to skip): ");
+            if (!initial.empty()) {
+                Money amt;
+                if (parseAmount(initial, amt)) {
+                    line += " " + formatMoney(amt);
+                } else {
+                    std::cout << "Invalid amount; starting with $0.00.\n";
+                }
+            }
+
+            std::string reply = call(server, line);
+            if (isOk(reply)) {
+                std::cout << "Account created. You can now log in.\n";
+            } else if (word(reply, 1) == "username-taken") {
+                std::cout << "Username already exists.\n";
+            } else {
+                printError(reply);
+            }
+        } else if (choice == "2") {
+            std::string username = prompt("Username: ");
+            std::string pin = prompt("PIN: ");
+            if (!isValidUsername(username) || !isValidPin(pin)) {
+                std::cout << "Invalid login.\n";
+                continue;
+            }
+
+            std::string reply = call(server, "LOGIN " + username + " " + pin);
+            std::string code = word(reply, 1);
+            if (isOk(reply)) {
+                accountMenu(server, username, code);
+            } else if (code == "locked") {
+                std::cout << "Account locked. Try again in " << word(reply, 2) << " seconds.\n";
+            } else if (code == "locked-out") {
+                std::cout << "Too many failed attempts. Account locked for " << word(reply, 2) << " seconds.\n";
+            } else if (code == "bad-pin") {
+                std::cout << "Invalid login. Attempts left: " << word(reply, 2) << ".\n";
+            } else if (code == "invalid-login") {
+                std::cout << "Invalid login.\n";
+            } else {
+                printError(reply);
+            }
+        } else if (choice == "3") {
+            call(server, "QUIT");
+            std::cout << "Goodbye.\n";
+            return;
+        } else {
+            std::cout << "Invalid option.\n";
+        }
+    }
+}
+
+} // namespace
+
+int runClient(const std::string& host, int port) {
+    ServerConnection server;
+    if (!server.open(host, port)) {
+        std::cout << "Could not connect to " << host << ":" << port << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::cout << "=== CLI Bank App (connected to " << host << ":" << port << ") ===\n";
+    try {
+        mainMenu(server);
+    } catch (const ConnectionLost&) {
+        std::cout << "Connection to server lost.\n";
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int runClient(const std::string&, int) {
+    std::cout << "The network client is not available on Windows yet; run the server mode on Linux and connect from there.\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef CLIENT_H
+#define CLIENT_H
+
+#include <string>
+
+// The interactive menu as a thin client of a running server (see server.h):
+// prompts locally, sends one protocol line per action. Returns the exit code.
+int runClient(const std::string& host, int port);
+
+#endif // CLIENT_H
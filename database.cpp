@@ -1,68 +1,150 @@
 #include "database.h"
+#include "migrations.h"
+#include "statements.h"
+#include <algorithm>
 
-Database::Database(const std::string& connStr) : conn_(connStr) {}
+namespace {
+// Idle connections older than this are pinged before being handed out;
+// hosted Postgres (Neon) drops sockets that sit idle for a while.
+const std::chrono::seconds kHealthCheckIdle(30);
+}
 
-Database::~Database() {}
+Database::Lease::Lease(Database* db, size_t slot, pqxx::connection* conn)
+    : db_(db), slot_(slot), conn_(conn) {}
 
-void Database::ensureSchema() {
-    pqxx::work tx(conn_);
-    tx.exec(R"SQL(
-        CREATE TABLE IF NOT EXISTS accounts (
-            id SERIAL PRIMARY KEY,
-            username TEXT UNIQUE NOT NULL,
-            pin_hash TEXT NOT NULL,
-            salt TEXT NOT NULL,
-            balance NUMERIC(12,2) NOT NULL DEFAULT 0,
-            failed_attempts INT NOT NULL DEFAULT 0,
-            locked_until BIGINT NOT NULL DEFAULT 0,
-            created_at TIMESTAMPTZ NOT NULL DEFAULT NOW()
-        );
-    )SQL");
-
-    tx.exec(R"SQL(
-        CREATE TABLE IF NOT EXISTS transactions (
-            id BIGSERIAL PRIMARY KEY,
-            account_id INT NOT NULL REFERENCES accounts(id),
-            type TEXT NOT NULL,
-            amount NUMERIC(12,2) NOT NULL,
-            counterparty TEXT,
-            note TEXT,
-            created_at TIMESTAMPTZ NOT NULL DEFAULT NOW()
-        );
-    )SQL");
-
-    tx.exec(R"SQL(
-        CREATE TABLE IF NOT EXISTS statements (
-            id BIGSERIAL PRIMARY KEY,
-            account_id INT NOT NULL REFERENCES accounts(id),
-            statement_month DATE NOT NULL,
-            generated_at TIMESTAMPTZ NOT NULL DEFAULT NOW(),
-            total_in NUMERIC(12,2) NOT NULL,
-            total_out NUMERIC(12,2) NOT NULL,
-            ending_balance NUMERIC(12,2) NOT NULL,
-            items_json TEXT NOT NULL
-        );
-    )SQL");
-
-    tx.exec(R"SQL(
-        CREATE UNIQUE INDEX IF NOT EXISTS statements_unique
-        ON statements(account_id, statement_month);
-    )SQL");
-
-    tx.exec(R"SQL(
-        CREATE TABLE IF NOT EXISTS login_logs (
-            id BIGSERIAL PRIMARY KEY,
-            account_id INT NOT NULL REFERENCES accounts(id),
-            login_time TIMESTAMPTZ NOT NULL DEFAULT NOW(),
-            success BOOLEAN NOT NULL,
-            ip_address TEXT,
-            user_agent TEXT
-        );
-    )SQL");
-
-    tx.commit();
+Database::Lease::Lease(Lease&& other) noexcept
+    : db_(other.db_), slot_(other.slot_), conn_(other.conn_) {
+    other.db_ = nullptr;
+    other.conn_ = nullptr;
+}
+
+Database::Lease::~Lease() {
+    if (db_) {
+        db_->release(slot_, !conn_->is_open());
+    }
 }
 
-pqxx::connection& Database::getConnection() {
+pqxx::connection& Database::Lease::operator*() const {
+    return *conn_;
+}
+
+pqxx::connection* Database::Lease::operator->() const {
     return conn_;
-}
\ No newline at end of file
+}
+
+void Database::Lease::markBroken() {
+    if (db_) {
+        std::lock_guard<std::mutex> lock(db_->mutex_);
+        db_->slots_[slot_].broken = true;
+    }
+}
+
+Database::Database(const std::string& connStr, size_t poolSize)
+    : connStr_(connStr), slots_(std::max<size_t>(poolSize, 1)) {
+    // Open one connection up front so a bad URL fails at startup; the rest
+    // are opened on first use.
+    slots_[0].conn = std::make_unique<pqxx::connection>(connStr_);
+    slots_[0].last_used = std::chrono::steady_clock::now();
+    for (size_t i = slots_.size(); i > 0; --i) {
+        idle_.push_back(i - 1);
+    }
+    stats_.size = slots_.size();
+}
+
+Database::~Database() {}
+
+Database::Lease Database::acquire() {
+    return acquireSlot(true);
+}
+
+Database::Lease Database::acquireSlot(bool prepare) {
+    auto start = std::chrono::steady_clock::now();
+    size_t index = 0;
+    bool waited = false;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (idle_.empty()) {
+            waited = true;
+            available_.wait(lock, [this] { return !idle_.empty(); });
+        }
+        index = idle_.back();
+        idle_.pop_back();
+
+        auto waitUs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        stats_.acquisitions += 1;
+        if (waited) stats_.waits += 1;
+        stats_.total_wait_us += waitUs;
+        stats_.max_wait_us = std::max(stats_.max_wait_us, waitUs);
+    }
+
+    try {
+        ensureHealthy(slots_[index], prepare);
+    } catch (...) {
+        release(index, true);
+        throw;
+    }
+    return Lease(this, index, slots_[index].conn.get());
+}
+
+// Runs without the pool lock: the slot is exclusively owned by the caller.
+void Database::ensureHealthy(Slot& slot, bool prepare) {
+    bool reconnect = !slot.conn || slot.broken || !slot.conn->is_open();
+
+    if (!reconnect && std::chrono::steady_clock::now() - slot.last_used > kHealthCheckIdle) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.health_checks += 1;
+        }
+        try {
+            pqxx::nontransaction ping(*slot.conn);
+            ping.exec("SELECT 1");
+        } catch (const pqxx::broken_connection&) {
+            reconnect = true;
+        }
+    }
+
+    if (reconnect) {
+        bool hadConnection = slot.conn != nullptr;
+        slot.conn.reset();
+        slot.conn = std::make_unique<pqxx::connection>(connStr_);
+        slot.broken = false;
+        slot.prepared = false;
+        if (hadConnection) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.reconnects += 1;
+        }
+    }
+
+    // Prepared on first real use, so the schema can be created on this connection first.
+    if (prepare && !slot.prepared && preparedStatementsEnabled()) {
+        prepareStatements(*slot.conn);
+        slot.prepared = true;
+    }
+}
+
+void Database::release(size_t slot, bool broken) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slots_[slot].broken = slots_[slot].broken || broken;
+        slots_[slot].last_used = std::chrono::steady_clock::now();
+        idle_.push_back(slot);
+    }
+    available_.notify_one();
+}
+
+size_t Database::poolSize() const {
+    return slots_.size();
+}
+
+PoolStats Database::poolStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PoolStats out = stats_;
+    out.idle = idle_.size();
+    return out;
+}
+
+void Database::ensureSchema() {
+    Lease conn = acquireSlot(false);
+    migrateSchema(*conn);
+}
@@ -2,18 +2,81 @@
 #define DATABASE_H
 
 #include <pqxx/pqxx>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+
+struct PoolStats {
+    size_t size = 0;
+    size_t idle = 0;
+    uint64_t acquisitions = 0;
+    uint64_t waits = 0;           // acquisitions that had to block for a free connection
+    uint64_t total_wait_us = 0;
+    uint64_t max_wait_us = 0;
+    uint64_t health_checks = 0;
+    uint64_t reconnects = 0;
+};
 
 class Database {
 public:
-    Database(const std::string& connStr);
+    static const size_t kDefaultPoolSize = 4;
+
+    // Exclusive use of one pooled connection; returned to the pool on destruction.
+    class Lease {
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        pqxx::connection& operator*() const;
+        pqxx::connection* operator->() const;
+
+        // Forces a reconnect before the connection is handed out again.
+        void markBroken();
+
+    private:
+        friend class Database;
+        Lease(Database* db, size_t slot, pqxx::connection* conn);
+
+        Database* db_;
+        size_t slot_;
+        pqxx::connection* conn_;
+    };
+
+    Database(const std::string& connStr, size_t poolSize = kDefaultPoolSize);
     ~Database();
 
+    // Applies any missing migrations (see migrations.h).
     void ensureSchema();
-    pqxx::connection& getConnection();
+    Lease acquire();
+    size_t poolSize() const;
+    PoolStats poolStats() const;
 
 private:
-    pqxx::connection conn_;
+    struct Slot {
+        std::unique_ptr<pqxx::connection> conn;
+        bool broken = false;
+        bool prepared = false;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    Lease acquireSlot(bool prepare);
+    void release(size_t slot, bool broken);
+    void ensureHealthy(Slot& slot, bool prepare);
+
+    std::string connStr_;
+    std::vector<Slot> slots_;
+    std::vector<size_t> idle_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    PoolStats stats_;
 };
 
-#endif // DATABASE_H
\ No newline at end of file
+#endif // DATABASE_H
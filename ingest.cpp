@@ -0,0 +1,576 @@
+#include "ingest.h"
+#include "account.h"
+#include "account_cache.h"
+#include "async_executor.h"
+#include "statements.h"
+#include "utils.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+const int kMaxAttempts = 5;
+const size_t kBatchesPerConnection = 4;   // in flight at once
+const size_t kResolveAhead = 16;          // batches whose names are looked up together
+
+enum class Op { Deposit, Withdraw, Transfer };
+
+struct Row {
+    long long line = 0;
+    std::string_view input;
+    Op op = Op::Deposit;
+    std::string username;
+    std::string to;
+    Money amount;
+    int account_id = 0;
+};
+
+// Input lines [first_line, first_line + line_count). rows holds the valid
+// ones; lines rejected up front are covered by the range but not sent.
+struct Batch {
+    long long first_line = 0;
+    long long line_count = 0;
+    std::vector<Row> rows;
+    int attempt = 0;
+};
+
+int backoffMs(int attempt) {
+    thread_local std::mt19937 gen(std::random_device{}());
+    int cap = std::min(100, 2 << attempt);
+    std::uniform_int_distribution<int> dist(cap / 2, cap);
+    return dist(gen);
+}
+
+bool endsWith(const std::string& s, const std::string& suffix) {
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+std::string lower(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    return s;
+}
+
+// Fields are plain text: usernames and amounts never need quoting.
+std::vector<std::string> splitCsv(std::string_view line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t comma = line.find(',', start);
+        fields.push_back(trim(std::string(line.substr(start, comma == std::string_view::npos ? std::string_view::npos : comma - start))));
+        if (comma == std::string_view::npos) return fields;
+        start = comma + 1;
+    }
+}
+
+// One flat JSON object with string, number or literal values. Nested values
+// and \u escapes are not supported (none of the fields can contain them).
+bool parseFlatJson(std::string_view s, std::unordered_map<std::string, std::string>& out) {
+    size_t i = 0;
+    auto skipSpace = [&] {
+        while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+    };
+    auto readString = [&](std::string& v) {
+        if (i >= s.size() || s[i] != '"') return false;
+        for (++i; i < s.size() && s[i] != '"'; ++i) {
+            char c = s[i];
+            if (c == '\\') {
+                if (++i >= s.size()) return false;
+                switch (s[i]) {
+                case '"': case '\\': case '/': c = s[i]; break;
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                default: return false;
+                }
+            }
+            v.push_back(c);
+        }
+        if (i >= s.size()) return false;
+        ++i;
+        return true;
+    };
+
+    skipSpace();
+    if (i >= s.size() || s[i] != '{') return false;
+    ++i;
+    skipSpace();
+    if (i < s.size() && s[i] == '}') {
+        ++i;
+        skipSpace();
+        return i == s.size();
+    }
+    while (true) {
+        std::string key;
+        std::string value;
+        skipSpace();
+        if (!readString(key)) return false;
+        skipSpace();
+        if (i >= s.size() || s[i] != ':') return false;
+        ++i;
+        skipSpace();
+        if (i < s.size() && s[i] == '"') {
+            if (!readString(value)) return false;
+        } else {
+            size_t start = i;
+            while (i < s.size() && s[i] != ',' && s[i] != '}' && !std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+            value = std::string(s.substr(start, i - start));
+            if (value.empty()) return false;
+            if (value == "null") value.clear();
+        }
+        out[key] = std::move(value);
+        skipSpace();
+        if (i < s.size() && s[i] == ',') {
+            ++i;
+            continue;
+        }
+        if (i < s.size() && s[i] == '}') {
+            ++i;
+            skipSpace();
+            return i == s.size();
+        }
+        return false;
+    }
+}
+
+// Returns the rejection reason, or "" when row is filled in.
+std::string validate(const std::string& op, const std::string& username, const std::string& amount, const std::string& to, Row& row) {
+    std::string name = lower(op);
+    if (name == "deposit") {
+        row.op = Op::Deposit;
+    } else if (name == "withdraw") {
+        row.op = Op::Withdraw;
+    } else if (name == "transfer") {
+        row.op = Op::Transfer;
+    } else {
+        return "unknown op";
+    }
+    if (!isValidUsername(username)) return "invalid username";
+    if (!parseAmount(amount, row.amount)) return "invalid amount";
+    if (row.op == Op::Transfer) {
+        if (!isValidUsername(to)) return "invalid recipient";
+        if (to == username) return "transfer to self";
+    } else if (!to.empty()) {
+        return "recipient given for " + name;
+    }
+    row.username = username;
+    row.to = to;
+    return "";
+}
+
+std::string quoteCsv(std::string_view s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') out.push_back('"');
+        out.push_back(c);
+    }
+    out.push_back('"');
+    return out;
+}
+
+std::string firstLine(const std::string& s) {
+    std::string line = trim(s.substr(0, s.find('\n')));
+    return line.empty() ? "database error" : line;
+}
+
+class Ingestor {
+public:
+    Ingestor(Database& db, const std::string& connStr, const IngestOptions& options)
+        : db_(db), options_(options), window_(std::max<size_t>(1, options.connections) * kBatchesPerConnection) {
+        std::ifstream in(options.path, std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot open " + options.path);
+        content_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        hash_ = toHex(fnv1a64(content_));
+        json_ = !endsWith(lower(options.path), ".csv");
+
+        std::string errorsPath = options.errors_path.empty() ? options.path + ".errors" : options.errors_path;
+        bool fresh = !std::ifstream(errorsPath).good();
+        errors_.open(errorsPath, std::ios::app);
+        if (!errors_) throw std::runtime_error("Cannot write " + errorsPath);
+        if (fresh) errors_ << "line,reason,input\n";
+
+        exec_.reset(new AsyncExecutor(connStr, std::max<size_t>(1, options.connections)));
+    }
+
+    IngestResult run() {
+        loadCommitted();
+        started_ = std::chrono::steady_clock::now();
+        lastProgress_ = started_;
+        std::cout << "Ingesting " << options_.path << " (" << hash_ << ") in batches of " << options_.batch_size
+                  << " on " << std::max<size_t>(1, options_.connections) << " pipelined connection(s).\n";
+
+        std::vector<Batch> pending;
+        Batch current;
+        auto flush = [&] {
+            if (current.line_count == 0) return;
+            pending.push_back(std::move(current));
+            current = Batch();
+            if (pending.size() >= kResolveAhead) submitAll(pending);
+        };
+
+        long long lineNo = 0;
+        bool first = true;
+        size_t pos = 0;
+        while (pos < content_.size()) {
+            size_t end = content_.find('\n', pos);
+            if (end == std::string::npos) end = content_.size();
+            std::string_view line(content_.data() + pos, end - pos);
+            pos = end + 1;
+            ++lineNo;
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (trim(std::string(line)).empty()) continue;
+
+            bool header = first && !json_ && lower(splitCsv(line)[0]) == "op";
+            first = false;
+            if (header) continue;
+
+            countLine();
+            if (isCommitted(lineNo)) {
+                flush();
+                std::lock_guard<std::mutex> lock(mutex_);
+                result_.skipped += 1;
+                continue;
+            }
+
+            if (current.line_count == 0) current.first_line = lineNo;
+            current.line_count = lineNo - current.first_line + 1;
+            Row row;
+            row.line = lineNo;
+            row.input = line;
+            std::string reason = parse(line, row);
+            if (reason.empty()) {
+                current.rows.push_back(std::move(row));
+            } else {
+                reject(lineNo, reason, line);
+            }
+            if (static_cast<size_t>(current.line_count) >= options_.batch_size) flush();
+        }
+        flush();
+        submitAll(pending);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (inFlight_ > 0) {
+                drained_.wait_for(lock, std::chrono::seconds(1));
+                progressLocked();
+            }
+        }
+        exec_.reset();
+        errors_.flush();
+
+        result_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started_).count();
+        std::cout << "Done: " << result_.applied << " applied, " << result_.skipped << " already ingested, "
+                  << result_.rejected << " rejected, " << result_.failed << " failed; " << result_.batches
+                  << " batches, " << result_.retries << " retries in " << std::fixed << std::setprecision(2)
+                  << result_.seconds << " s (" << std::setprecision(0)
+                  << (result_.applied + result_.failed) / std::max(result_.seconds, 1e-9) << " ops/s).\n";
+        if (result_.rejected + result_.failed + reported_ > 0) {
+            std::cout << "Rows that were rejected, failed or found already ingested were appended to "
+                      << (options_.errors_path.empty() ? options_.path + ".errors" : options_.errors_path) << ".\n";
+        }
+        return result_;
+    }
+
+private:
+    std::string parse(std::string_view line, Row& row) const {
+        if (json_) {
+            std::unordered_map<std::string, std::string> fields;
+            if (!parseFlatJson(line, fields)) return "malformed JSON";
+            return validate(fields["op"], fields["username"], fields["amount"], fields["to"], row);
+        }
+        std::vector<std::string> fields = splitCsv(line);
+        if (fields.size() < 3 || fields.size() > 4) return "expected op,username,amount[,to]";
+        return validate(fields[0], fields[1], fields[2], fields.size() > 3 ? fields[3] : "", row);
+    }
+
+    void loadCommitted() {
+        Database::Lease conn = db_.acquire();
+        pqxx::nontransaction tx(*conn);
+        pqxx::result res = execStatement(tx, stmt::IngestedRanges, hash_);
+        for (const auto& row : res) {
+            long long first = row["first_line"].as<long long>();
+            committed_.emplace_back(first, first + row["line_count"].as<long long>());
+        }
+    }
+
+    // Lines arrive in ascending order, so one cursor walks the sorted ranges.
+    bool isCommitted(long long line) {
+        while (nextRange_ < committed_.size() && committed_[nextRange_].second <= line) ++nextRange_;
+        return nextRange_ < committed_.size() && committed_[nextRange_].first <= line;
+    }
+
+    void countLine() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.lines += 1;
+    }
+
+    void reject(long long line, const std::string& reason, std::string_view input) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.rejected += 1;
+        errors_ << line << "," << reason << "," << quoteCsv(input) << "\n";
+    }
+
+    void fail(const Row& row, const std::string& reason) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.failed += 1;
+        errors_ << row.line << "," << reason << "," << quoteCsv(row.input) << "\n";
+    }
+
+    // One ResolveUsernames round-trip for every name in pending not seen before.
+    void resolve(std::vector<Batch>& pending) {
+        std::string literal;
+        for (const Batch& b : pending) {
+            for (const Row& r : b.rows) {
+                if (ids_.count(r.username)) continue;
+                ids_[r.username] = 0;
+                literal += literal.empty() ? "{\"" : ",\"";
+                literal += r.username;   // isValidUsername: no quotes or backslashes
+                literal += "\"";
+            }
+        }
+        if (!literal.empty()) {
+            literal += "}";
+            Database::Lease conn = db_.acquire();
+            pqxx::nontransaction tx(*conn);
+            pqxx::result res = execStatement(tx, stmt::ResolveUsernames, literal);
+            for (const auto& row : res) ids_[row["username"].c_str()] = row["id"].as<int>();
+        }
+
+        for (Batch& b : pending) {
+            std::vector<Row> known;
+            known.reserve(b.rows.size());
+            for (Row& r : b.rows) {
+                r.account_id = ids_[r.username];
+                if (r.account_id == 0) {
+                    reject(r.line, "unknown account", r.input);
+                } else {
+                    known.push_back(std::move(r));
+                }
+            }
+            b.rows = std::move(known);
+        }
+    }
+
+    void submitAll(std::vector<Batch>& pending) {
+        resolve(pending);
+        for (Batch& b : pending) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (inFlight_ >= window_) {
+                    drained_.wait_for(lock, std::chrono::seconds(1));
+                    progressLocked();
+                }
+                inFlight_ += 1;
+                result_.batches += 1;
+                progressLocked();
+            }
+            send(std::make_shared<Batch>(std::move(b)));
+        }
+        pending.clear();
+    }
+
+    void send(std::shared_ptr<Batch> b, std::chrono::milliseconds delay = std::chrono::milliseconds(0)) {
+        std::vector<AsyncStatement> statements;
+        statements.reserve(b->rows.size() + 1);
+        statements.push_back(AsyncStatement{stmt::IngestCheckpoint,
+            {hash_, std::to_string(b->first_line), std::to_string(b->line_count)}});
+        for (const Row& r : b->rows) {
+            std::string id = std::to_string(r.account_id);
+            std::string cents = std::to_string(r.amount.cents());
+            switch (r.op) {
+            case Op::Deposit:
+                statements.push_back(AsyncStatement{stmt::DepositFunds, {id, cents}});
+                break;
+            case Op::Withdraw:
+                statements.push_back(AsyncStatement{stmt::WithdrawFunds, {id, cents}});
+                break;
+            case Op::Transfer:
+                statements.push_back(AsyncStatement{stmt::TransferFunds, {id, r.to, cents}});
+                break;
+            }
+        }
+        exec_->submit(std::move(statements), [this, b](AsyncBatchResult r) { completed(b, std::move(r)); }, delay);
+    }
+
+    // Runs on the executor's driver thread: must not block.
+    void completed(const std::shared_ptr<Batch>& b, AsyncBatchResult r) {
+        if (r.ok) {
+            applied(*b, r);
+            release(1);
+            return;
+        }
+        if (r.sqlstate == "23505" && !r.results.empty() && !r.results[0].ok) {
+            // The checkpoint exists: this batch committed before its reply was
+            // lost, or another run of the file got there first. Read which
+            // lines it covers before reporting the rows.
+            exec_->submit({AsyncStatement{stmt::IngestedBatch, {hash_, std::to_string(b->first_line)}}},
+                          [this, b](AsyncBatchResult found) { alreadyIngested(b, std::move(found)); });
+            return;
+        }
+
+        bool retryable = r.connection_lost || r.sqlstate == "40P01" || r.sqlstate == "40001";
+        if (retryable && ++b->attempt < kMaxAttempts) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                result_.retries += 1;
+            }
+            send(b, std::chrono::milliseconds(backoffMs(b->attempt - 1)));
+            return;
+        }
+
+        if (!retryable && b->rows.size() > 1) {
+            // Run each row on its own, each covering the lines up to the next
+            // row, so the ranges still tile the batch exactly.
+            std::vector<std::shared_ptr<Batch>> singles;
+            for (size_t i = 0; i < b->rows.size(); ++i) {
+                auto single = std::make_shared<Batch>();
+                single->first_line = i == 0 ? b->first_line : b->rows[i].line;
+                long long end = i + 1 < b->rows.size() ? b->rows[i + 1].line : b->first_line + b->line_count;
+                single->line_count = end - single->first_line;
+                single->rows.push_back(std::move(b->rows[i]));
+                singles.push_back(std::move(single));
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                inFlight_ += singles.size() - 1;
+                result_.batches += singles.size() - 1;
+            }
+            for (auto& single : singles) send(single);
+            return;
+        }
+
+        // A lost connection or repeated deadlocks leave no checkpoint, so a
+        // rerun tries these rows again; a row the database refuses is final.
+        std::string reason = retryable ? "gave up after " + std::to_string(kMaxAttempts) + " attempts: " + firstLine(r.error)
+                                       : firstLine(r.error);
+        for (const Row& row : b->rows) fail(row, reason);
+        if (!retryable && !b->rows.empty()) {
+            b->rows.clear();
+            b->attempt = 0;
+            send(b);
+            return;
+        }
+        release(1);
+    }
+
+    // Rows inside the committed range are reported as skipped. Rows past it
+    // (a concurrent run used a different batch size) were not applied; they
+    // are reported as failed, and a rerun picks them up.
+    void alreadyIngested(const std::shared_ptr<Batch>& b, const AsyncBatchResult& found) {
+        if (!found.ok || found.results.empty() || found.results[0].rows.empty() || !found.results[0].rows[0][0]) {
+            std::string reason = "checkpoint for line " + std::to_string(b->first_line) + " exists but could not be read: " +
+                                 (found.ok ? std::string("no row") : firstLine(found.error));
+            for (const Row& row : b->rows) fail(row, reason);
+            release(1);
+            return;
+        }
+
+        long long end = b->first_line + std::stoll(*found.results[0].rows[0][0]);
+        std::string range = "lines " + std::to_string(b->first_line) + "-" + std::to_string(end - 1);
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Row& row : b->rows) {
+            if (row.line < end) {
+                result_.skipped += 1;
+                reported_ += 1;
+                errors_ << row.line << ",already ingested (" << range << ")," << quoteCsv(row.input) << "\n";
+            } else {
+                result_.failed += 1;
+                errors_ << row.line << ",not ingested: another run committed " << range << "; rerun the file,"
+                        << quoteCsv(row.input) << "\n";
+            }
+        }
+        releaseLocked(1);
+    }
+
+    void applied(const Batch& b, const AsyncBatchResult& r) {
+        AccountCache& cache = accountCache();
+        size_t ok = 0;
+        for (size_t i = 0; i < b.rows.size(); ++i) {
+            const Row& row = b.rows[i];
+            const AsyncResult& res = r.results[i + 1];
+            std::string reason;
+            if (row.op == Op::Transfer) {
+                const auto& cols = res.rows.at(0);
+                if (!cols[0] || *cols[0] == "0") {
+                    reason = "unknown account";
+                } else if (!cols[1] || *cols[1] == "0") {
+                    reason = "unknown recipient";
+                } else if (!cols[2]) {
+                    reason = "insufficient funds";
+                } else if (cols.size() > 3 && cols[3]) {
+                    cache.invalidate(std::stoi(*cols[3]));
+                }
+            } else if (res.rows.empty()) {
+                reason = row.op == Op::Withdraw ? "insufficient funds" : "unknown account";
+            }
+
+            if (reason.empty()) {
+                cache.invalidate(row.account_id);
+                ++ok;
+            } else {
+                fail(row, reason);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        result_.applied += ok;
+    }
+
+    void release(size_t n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        releaseLocked(n);
+    }
+
+    void releaseLocked(size_t n) {
+        inFlight_ -= n;
+        drained_.notify_all();
+    }
+
+    void progressLocked() {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastProgress_ < std::chrono::seconds(1)) return;
+        lastProgress_ = now;
+        double elapsed = std::chrono::duration<double>(now - started_).count();
+        std::cout << "  " << result_.lines << " lines read, " << result_.applied << " applied, "
+                  << result_.rejected + result_.failed << " errors, " << std::fixed << std::setprecision(0)
+                  << (result_.applied + result_.failed) / elapsed << " ops/s\n";
+    }
+
+    Database& db_;
+    IngestOptions options_;
+    size_t window_;
+    std::string content_;
+    std::string hash_;
+    bool json_ = false;
+    std::vector<std::pair<long long, long long>> committed_;   // [first, end) line ranges
+    size_t nextRange_ = 0;
+    std::unordered_map<std::string, int> ids_;                  // 0: no such account
+    std::unique_ptr<AsyncExecutor> exec_;
+
+    std::mutex mutex_;                                          // everything below
+    std::condition_variable drained_;
+    size_t inFlight_ = 0;
+    IngestResult result_;
+    size_t reported_ = 0;                                       // skipped rows written to errors_
+    std::ofstream errors_;
+    std::chrono::steady_clock::time_point started_;
+    std::chrono::steady_clock::time_point lastProgress_;
+};
+
+} // namespace
+
+IngestResult runIngest(Database& db, const std::string& connStr, const IngestOptions& options) {
+    Ingestor ingestor(db, connStr, options);
+    return ingestor.run();
+}
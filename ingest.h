@@ -0,0 +1,48 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <cstddef>
+#include <string>
+#include "database.h"
+
+struct IngestOptions {
+    std::string path;
+    std::string errors_path;    // default: <path>.errors
+    size_t batch_size = 500;    // input lines per committed batch
+    size_t connections = 2;     // pipelined connections; 1 applies batches in file order
+};
+
+struct IngestResult {
+    size_t lines = 0;           // operation lines read (header and blank lines excluded)
+    size_t applied = 0;
+    size_t skipped = 0;         // in batches committed by an earlier run
+    size_t rejected = 0;        // failed validation or named an unknown account
+    size_t failed = 0;          // insufficient funds, unknown recipient, database errors
+    size_t batches = 0;
+    size_t retries = 0;
+    double seconds = 0.0;
+};
+
+// Applies a file of deposits, withdrawals and transfers without the menu.
+// *.csv files have the columns op,username,amount[,to] (a header row starting
+// with "op" is skipped); any other extension is read as NDJSON, one
+// {"op":..,"username":..,"amount":..,"to":..} object per line. Rows are
+// validated with isValidUsername/parseAmount and account names are resolved
+// in bulk, once per name.
+//
+// Consecutive lines are grouped into batches that run on the AsyncExecutor:
+// each batch is one pipelined round-trip and one commit, and carries an
+// ingest_batches row keyed by the file's hash and its first line. A rerun of
+// the same file skips every committed batch, so an interrupted ingestion is
+// resumed by running it again. A batch that fails as a whole is retried on
+// deadlocks and lost connections, and otherwise split into single rows so
+// only the offending row is reported.
+//
+// Every rejected or failed row goes to errors_path as "line,reason,input".
+// So do the rows of a batch whose checkpoint turns out to exist already (its
+// reply was lost, or another run got there first), with the committed line
+// range as the reason.
+// POSIX only (the executor needs it).
+IngestResult runIngest(Database& db, const std::string& connStr, const IngestOptions& options);
+
+#endif // INGEST_H
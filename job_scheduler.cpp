@@ -0,0 +1,138 @@
+#include "job_scheduler.h"
+#include <algorithm>
+
+namespace {
+double msBetween(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+    return std::chrono::duration<double, std::milli>(b - a).count();
+}
+}
+
+const char* jobStateName(JobState state) {
+    switch (state) {
+        case JobState::Queued: return "queued";
+        case JobState::Running: return "running";
+        case JobState::Succeeded: return "done";
+        case JobState::Failed: return "failed";
+    }
+    return "?";
+}
+
+JobScheduler::JobScheduler(Database& db, size_t workers, size_t queueCapacity)
+    : db_(db), capacity_(std::max<size_t>(queueCapacity, 1)) {
+    stats_.workers = std::max<size_t>(workers, 1);
+    for (size_t i = 0; i < stats_.workers; ++i) {
+        workers_.emplace_back(&JobScheduler::runWorker, this);
+    }
+}
+
+JobScheduler::~JobScheduler() {
+    shutdown();
+}
+
+uint64_t JobScheduler::trySubmit(const std::string& name, Job job, FailureHandler onFailure) {
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || queue_.size() >= capacity_) {
+            stats_.rejected += 1;
+            return 0;
+        }
+        id = nextId_++;
+        JobStatus st;
+        st.id = id;
+        st.name = name;
+        jobs_[id] = st;
+        queue_.push_back(Pending{id, std::move(job), std::move(onFailure), Clock::now()});
+        stats_.submitted += 1;
+    }
+    wake_.notify_one();
+    return id;
+}
+
+bool JobScheduler::status(uint64_t id, JobStatus& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = jobs_.find(id);
+    if (it == jobs_.end()) return false;
+    out = it->second;
+    return true;
+}
+
+JobSchedulerStats JobScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    JobSchedulerStats out = stats_;
+    out.queue_depth = queue_.size();
+    uint64_t done = stats_.succeeded + stats_.failed;
+    out.avg_latency_ms = done > 0 ? totalLatencyMs_ / static_cast<double>(done) : 0.0;
+    return out;
+}
+
+void JobScheduler::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+// A lease is taken per job rather than per worker, so a connection that sat
+// idle between jobs goes through the pool's health check and is reconnected
+// instead of failing the next job.
+void JobScheduler::runWorker() {
+    while (true) {
+        Pending next;
+        Clock::time_point started;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            next = std::move(queue_.front());
+            queue_.pop_front();
+            started = Clock::now();
+            jobs_[next.id].state = JobState::Running;
+            jobs_[next.id].queued_ms = msBetween(next.submitted, started);
+            stats_.running += 1;
+        }
+
+        try {
+            Database::Lease conn = db_.acquire();
+            try {
+                next.job(*conn);
+            } catch (const pqxx::broken_connection&) {
+                conn.markBroken();
+                throw;
+            }
+            finish(next.id, true, "", next.submitted, started);
+        } catch (const std::exception& ex) {
+            finish(next.id, false, ex.what(), next.submitted, started);
+            if (next.onFailure) next.onFailure(ex.what());
+        }
+    }
+}
+
+void JobScheduler::finish(uint64_t id, bool ok, const std::string& error, Clock::time_point submitted, Clock::time_point started) {
+    Clock::time_point ended = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    JobStatus& st = jobs_[id];
+    st.state = ok ? JobState::Succeeded : JobState::Failed;
+    st.error = error;
+    st.run_ms = msBetween(started, ended);
+
+    stats_.running -= 1;
+    if (ok) {
+        stats_.succeeded += 1;
+    } else {
+        stats_.failed += 1;
+    }
+    double latency = msBetween(submitted, ended);
+    totalLatencyMs_ += latency;
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency);
+
+    finished_.push_back(id);
+    if (finished_.size() > kFinishedHistory) {
+        jobs_.erase(finished_.front());
+        finished_.pop_front();
+    }
+}
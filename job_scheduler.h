@@ -0,0 +1,93 @@
+#ifndef JOB_SCHEDULER_H
+#define JOB_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "database.h"
+
+enum class JobState { Queued, Running, Succeeded, Failed };
+
+const char* jobStateName(JobState state);
+
+struct JobStatus {
+    uint64_t id = 0;
+    std::string name;
+    JobState state = JobState::Queued;
+    std::string error;
+    double queued_ms = 0.0;    // time spent waiting for a worker
+    double run_ms = 0.0;
+};
+
+struct JobSchedulerStats {
+    size_t workers = 0;
+    size_t queue_depth = 0;
+    size_t running = 0;
+    uint64_t submitted = 0;
+    uint64_t rejected = 0;     // trySubmit() calls refused because the queue was full
+    uint64_t succeeded = 0;
+    uint64_t failed = 0;
+    double avg_latency_ms = 0.0;   // submit to finish
+    double max_latency_ms = 0.0;
+};
+
+// Fixed pool of background workers with a bounded queue. Each job runs on a
+// pooled connection leased for that job alone.
+class JobScheduler {
+public:
+    using Job = std::function<void(pqxx::connection&)>;
+    // Told the error when a job fails, including when no connection could be leased for it.
+    using FailureHandler = std::function<void(const std::string&)>;
+
+    static const size_t kDefaultWorkers = 2;
+    static const size_t kDefaultQueueCapacity = 16;
+    static const size_t kFinishedHistory = 256;
+
+    JobScheduler(Database& db, size_t workers = kDefaultWorkers, size_t queueCapacity = kDefaultQueueCapacity);
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    // Returns the job id, or 0 when the queue is full.
+    uint64_t trySubmit(const std::string& name, Job job, FailureHandler onFailure = FailureHandler());
+    bool status(uint64_t id, JobStatus& out) const;
+    JobSchedulerStats stats() const;
+    // Runs whatever is still queued, then joins the workers.
+    void shutdown();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        uint64_t id;
+        Job job;
+        FailureHandler onFailure;
+        Clock::time_point submitted;
+    };
+
+    void runWorker();
+    void finish(uint64_t id, bool ok, const std::string& error, Clock::time_point submitted, Clock::time_point started);
+
+    Database& db_;
+    size_t capacity_;
+    std::deque<Pending> queue_;
+    std::map<uint64_t, JobStatus> jobs_;
+    std::deque<uint64_t> finished_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    uint64_t nextId_ = 1;
+    JobSchedulerStats stats_;
+    double totalLatencyMs_ = 0.0;
+    std::vector<std::thread> workers_;
+};
+
+#endif // JOB_SCHEDULER_H
@@ -0,0 +1,237 @@
+#include "journal.h"
+#include "account.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char kMagic[8] = {'B', 'A', 'N', 'K', 'J', 'N', 'L', '1'};
+const size_t kHeaderSize = 32;        // magic, u64 generation, reserved
+const size_t kRecordHeaderSize = 16;  // u32 length, u32 unused, u64 checksum
+
+std::runtime_error journalError(const std::string& what, const std::string& path) {
+    return std::runtime_error("Journal " + path + ": " + what + " (" + std::strerror(errno) + ")");
+}
+
+uint32_t readU32(const char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+uint64_t readU64(const char* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+size_t pageSize() {
+    static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+} // namespace
+
+Journal::Journal(const std::string& path, bool fsync, size_t chunk)
+    : path_(path), fsync_(fsync), chunk_(std::max(chunk, pageSize())) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) throw journalError("open failed", path_);
+
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+        ::close(fd_);
+        throw journalError("stat failed", path_);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > kMaxBytes) {
+        ::close(fd_);
+        throw std::runtime_error("Journal " + path_ + " is larger than the mappable limit");
+    }
+
+    void* p = ::mmap(nullptr, kMaxBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd_);
+        throw journalError("mmap failed", path_);
+    }
+    data_ = static_cast<char*>(p);
+
+    // A file whose header was never written holds no records either: it was
+    // just created, or an older reset() stopped between truncate and header.
+    bool unwritten = size_ == 0 || (data_[0] == 0 && std::memcmp(data_, data_ + 1, std::min(size_, kHeaderSize) - 1) == 0);
+    if (unwritten) {
+        grow(kHeaderSize);
+        writeHeader(1);
+        fresh_ = true;
+    } else if (size_ < kHeaderSize || std::memcmp(data_, kMagic, sizeof kMagic) != 0) {
+        ::munmap(data_, kMaxBytes);
+        ::close(fd_);
+        throw std::runtime_error("Journal " + path_ + " is not a ledger journal");
+    }
+    end_ = kHeaderSize;
+    stats_.generation = readU64(data_ + 8);
+}
+
+Journal::~Journal() {
+    if (fsync_ && data_) ::msync(data_, std::max(end_, kHeaderSize), MS_SYNC);
+    if (data_) ::munmap(data_, kMaxBytes);
+    if (fd_ >= 0) ::close(fd_);
+}
+
+uint64_t Journal::generation() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_.generation;
+}
+
+void Journal::grow(size_t needed) {
+    if (needed <= size_) return;
+    if (needed > kMaxBytes) throw std::runtime_error("Journal " + path_ + " is full; take a snapshot");
+    size_t size = (needed + chunk_ - 1) / chunk_ * chunk_;
+    if (size > kMaxBytes) size = kMaxBytes;
+    if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) throw journalError("grow failed", path_);
+    size_ = size;
+}
+
+void Journal::writeHeader(uint64_t generation) {
+    std::memset(data_, 0, kHeaderSize);
+    std::memcpy(data_, kMagic, sizeof kMagic);
+    std::memcpy(data_ + 8, &generation, sizeof generation);
+    if (fsync_ && ::msync(data_, pageSize(), MS_SYNC) != 0) throw journalError("sync failed", path_);
+}
+
+uint64_t Journal::replay(const std::function<void(std::string_view)>& apply) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t pos = kHeaderSize;
+    uint64_t count = 0;
+    while (pos + kRecordHeaderSize <= size_) {
+        uint32_t len = readU32(data_ + pos);
+        if (len == 0 || len > size_ - pos - kRecordHeaderSize) break;
+        std::string_view payload(data_ + pos + kRecordHeaderSize, len);
+        if (fnv1a64(payload) != readU64(data_ + pos + 8)) break;
+        apply(payload);
+        pos += kRecordHeaderSize + len;
+        ++count;
+    }
+    end_ = pos;
+
+    // Clear whatever a torn write left behind, so a later shorter record can
+    // never line up with a stale intact one.
+    const char* tail = data_ + end_;
+    size_t tailLen = size_ - end_;
+    if (tailLen > 0 && (tail[0] != 0 || std::memcmp(tail, tail + 1, tailLen - 1) != 0)) {
+        std::memset(data_ + end_, 0, tailLen);
+        if (fsync_ && ::msync(data_, size_, MS_SYNC) != 0) throw journalError("sync failed", path_);
+    }
+    durable_ = base_ + end_;
+    return count;
+}
+
+uint64_t Journal::append(std::string_view payload) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    grow(end_ + kRecordHeaderSize + payload.size() + kRecordHeaderSize);  // room for the end marker
+
+    uint32_t len = static_cast<uint32_t>(payload.size());
+    uint32_t unused = 0;
+    uint64_t checksum = fnv1a64(payload);
+    char* p = data_ + end_;
+    std::memcpy(p + kRecordHeaderSize, payload.data(), payload.size());
+    std::memcpy(p + 4, &unused, sizeof unused);
+    std::memcpy(p + 8, &checksum, sizeof checksum);
+    std::memcpy(p, &len, sizeof len);
+
+    end_ += kRecordHeaderSize + payload.size();
+    appendedRecords_ += 1;
+    stats_.records += 1;
+    return base_ + end_;
+}
+
+void Journal::sync(uint64_t lsn) {
+    if (!fsync_) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (durable_ < lsn) {
+        if (syncing_) {
+            synced_.wait(lock);
+            continue;
+        }
+
+        // Lead this round: everything appended so far goes out in one msync.
+        syncing_ = true;
+        uint64_t target = base_ + end_;
+        uint64_t records = appendedRecords_;
+        size_t from = static_cast<size_t>(std::max(durable_, base_) - base_) / pageSize() * pageSize();
+        size_t to = end_;
+        lock.unlock();
+        int rc = ::msync(data_ + from, to - from, MS_SYNC);
+        lock.lock();
+
+        syncing_ = false;
+        synced_.notify_all();
+        if (rc != 0) throw journalError("sync failed", path_);
+        durable_ = std::max(durable_, target);
+        stats_.syncs += 1;
+        stats_.synced_records += records - std::min(records, durableRecords_);
+        durableRecords_ = std::max(durableRecords_, records);
+    }
+}
+
+void Journal::reset(uint64_t generation) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    synced_.wait(lock, [this] { return !syncing_; });
+
+    // In place, so the header stays valid whenever a crash lands: first end
+    // the log before its first record (the old generation, now empty, which
+    // LocalLedger takes as already snapshotted), then switch the header to
+    // the new generation, then hand the record space back.
+    if (size_ >= kHeaderSize + kRecordHeaderSize) {
+        std::memset(data_ + kHeaderSize, 0, kRecordHeaderSize);
+        if (fsync_ && ::msync(data_, pageSize(), MS_SYNC) != 0) throw journalError("sync failed", path_);
+    }
+    std::memcpy(data_ + 8, &generation, sizeof generation);
+    if (fsync_ && ::msync(data_, pageSize(), MS_SYNC) != 0) throw journalError("sync failed", path_);
+    if (::ftruncate(fd_, static_cast<off_t>(kHeaderSize)) != 0) throw journalError("truncate failed", path_);
+    size_ = kHeaderSize;
+    fresh_ = false;
+
+    base_ += end_;
+    end_ = kHeaderSize;
+    durable_ = base_ + end_;
+    durableRecords_ = appendedRecords_;
+    stats_.generation = generation;
+    synced_.notify_all();
+}
+
+bool Journal::fresh() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fresh_;
+}
+
+JournalStats Journal::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    JournalStats out = stats_;
+    out.bytes = end_;
+    return out;
+}
+
+#else
+
+Journal::Journal(const std::string&, bool, size_t) {
+    throw std::runtime_error("The local ledger journal needs a POSIX system");
+}
+
+Journal::~Journal() {}
+uint64_t Journal::generation() const { return 0; }
+bool Journal::fresh() const { return false; }
+uint64_t Journal::replay(const std::function<void(std::string_view)>&) { return 0; }
+uint64_t Journal::append(std::string_view) { return 0; }
+void Journal::sync(uint64_t) {}
+void Journal::reset(uint64_t) {}
+JournalStats Journal::stats() const { return JournalStats(); }
+
+#endif
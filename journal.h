@@ -0,0 +1,86 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+struct JournalStats {
+    uint64_t generation = 0;
+    uint64_t records = 0;          // appended since open (replayed ones not counted)
+    uint64_t bytes = 0;            // current journal length, header included
+    uint64_t syncs = 0;            // msync(MS_SYNC) calls
+    uint64_t synced_records = 0;   // records made durable by those calls
+};
+
+// Append-only record log in a memory-mapped file. Records are
+// [u32 length][u32 unused][u64 fnv1a64][payload]; a zero length marks the end.
+// kMaxBytes of address space is mapped once and the file grows into it in
+// chunk-sized steps, so the mapping never moves while a sync is running.
+//
+// Durability uses group commit: append() returns a log sequence number and
+// sync(lsn) blocks until that record is on disk. The first waiter syncs
+// everything written so far while later writers keep appending. When it
+// finishes, the next waiter syncs the whole batch that built up meanwhile, so
+// the number of syncs follows disk latency, not commit rate.
+//
+// append() and reset() must be serialised by the caller (LocalLedger holds its
+// state lock); sync() and stats() may be called from any thread.
+// POSIX only; the constructor throws elsewhere.
+class Journal {
+public:
+    static const size_t kDefaultChunk = 16u << 20;
+    static const size_t kMaxBytes = size_t(1) << 30;
+
+    // Opens or creates path. Nothing is replayed until replay() is called.
+    Journal(const std::string& path, bool fsync, size_t chunk = kDefaultChunk);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    uint64_t generation() const;
+    // True when open found no journal to speak of (missing, empty or without
+    // a header) and started generation 1; false again after reset().
+    bool fresh() const;
+    // Calls apply for each intact record in order, then cuts the log after the
+    // last one (a torn write at the tail is discarded). Returns the record count.
+    uint64_t replay(const std::function<void(std::string_view)>& apply);
+    // Throws once the journal would pass kMaxBytes; snapshot and reset first.
+    uint64_t append(std::string_view payload);
+    // No-op when fsync is off: records then reach disk when the kernel writes
+    // the pages back (they survive a process crash, not a power loss).
+    void sync(uint64_t lsn);
+    // Drops every record and starts generation; everything appended so far
+    // counts as durable (the caller has just written a snapshot of it).
+    void reset(uint64_t generation);
+    JournalStats stats() const;
+
+private:
+    void grow(size_t needed);
+    void writeHeader(uint64_t generation);
+
+    std::string path_;
+    bool fsync_;
+    size_t chunk_;
+    int fd_ = -1;
+    char* data_ = nullptr;
+    size_t size_ = 0;              // file length; the mapping is kMaxBytes
+    size_t end_ = 0;               // offset where the next record goes
+    bool fresh_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable synced_;
+    uint64_t base_ = 0;            // LSN of offset 0 in the current generation
+    uint64_t durable_ = 0;         // LSNs up to here are on disk
+    bool syncing_ = false;
+    uint64_t appendedRecords_ = 0;
+    uint64_t durableRecords_ = 0;
+    JournalStats stats_;
+};
+
+#endif // JOURNAL_H
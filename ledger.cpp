@@ -0,0 +1,57 @@
+#include "ledger.h"
+
+PostgresLedger::PostgresLedger(pqxx::connection& conn, ReadSession* reads) : conn_(conn), reads_(reads) {}
+
+const char* PostgresLedger::name() const {
+    return "Neon-backed";
+}
+
+bool PostgresLedger::fetchAccountByUsername(const std::string& username, Account& out) {
+    return ::fetchAccountByUsername(conn_, username, out);
+}
+
+int PostgresLedger::createAccount(const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance) {
+    int new_id = 0;
+    try {
+        new_id = ::createAccount(conn_, username, pin_hash, salt, initial_balance);
+    } catch (const pqxx::unique_violation&) {
+        return 0;
+    }
+    noteWrite();
+    return new_id;
+}
+
+LoginResult PostgresLedger::authenticate(const std::string& username, const std::string& pin, long long now) {
+    return ::authenticate(conn_, username, pin, now);
+}
+
+void PostgresLedger::deposit(int account_id, Money amount, Money& new_balance) {
+    depositFunds(conn_, account_id, amount, new_balance);
+    noteWrite();
+}
+
+bool PostgresLedger::withdraw(int account_id, Money amount, Money& new_balance) {
+    bool ok = withdrawFunds(conn_, account_id, amount, new_balance);
+    if (ok) noteWrite();
+    return ok;
+}
+
+TransferStatus PostgresLedger::transfer(int from_id, const std::string& to_username, Money amount, Money& new_balance) {
+    TransferStatus status = transferFunds(conn_, from_id, to_username, amount, new_balance);
+    if (status == TransferStatus::Ok) noteWrite();
+    return status;
+}
+
+void PostgresLedger::recordEntry(int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note) {
+    pqxx::work tx(conn_);
+    recordTransaction(tx, account_id, kind, amount, counterparty, note);
+    tx.commit();
+    noteWrite();
+}
+
+HistoryPage PostgresLedger::historyPage(int account_id, long long anchor_id, HistoryDirection dir, int page_size) {
+    if (!reads_) return fetchHistoryPage(conn_, account_id, anchor_id, dir, page_size);
+    return reads_->read([&](pqxx::connection& conn) {
+        return fetchHistoryPage(conn, account_id, anchor_id, dir, page_size);
+    });
+}
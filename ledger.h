@@ -0,0 +1,58 @@
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <string>
+#include <pqxx/pqxx>
+#include "account.h"
+#include "replica.h"
+#include "transaction.h"
+#include "transfer.h"
+
+// The account and ledger operations behind the interactive menu, so they can
+// run against Postgres or the in-process LocalLedger. Statements, exports and
+// the server stay Postgres-only.
+class Ledger {
+public:
+    virtual ~Ledger() = default;
+
+    virtual const char* name() const = 0;
+    virtual bool fetchAccountByUsername(const std::string& username, Account& out) = 0;
+    // Records an InitialDeposit row when initial_balance is positive. Returns
+    // the new id, or 0 if the username is taken.
+    virtual int createAccount(const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance) = 0;
+    virtual LoginResult authenticate(const std::string& username, const std::string& pin, long long now) = 0;
+    virtual void deposit(int account_id, Money amount, Money& new_balance) = 0;
+    virtual bool withdraw(int account_id, Money amount, Money& new_balance) = 0;
+    virtual TransferStatus transfer(int from_id, const std::string& to_username, Money amount, Money& new_balance) = 0;
+    // A ledger row that moves no money (e.g. FakeTransfer).
+    virtual void recordEntry(int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note) = 0;
+    virtual HistoryPage historyPage(int account_id, long long anchor_id, HistoryDirection dir, int page_size = kHistoryPageSize) = 0;
+};
+
+// Forwards to the Postgres functions on one (leased) connection. With a
+// ReadSession on that connection, history pages are read from the replica
+// and every write is noted for read-your-writes.
+class PostgresLedger : public Ledger {
+public:
+    explicit PostgresLedger(pqxx::connection& conn, ReadSession* reads = nullptr);
+
+    const char* name() const override;
+    bool fetchAccountByUsername(const std::string& username, Account& out) override;
+    int createAccount(const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance) override;
+    LoginResult authenticate(const std::string& username, const std::string& pin, long long now) override;
+    void deposit(int account_id, Money amount, Money& new_balance) override;
+    bool withdraw(int account_id, Money amount, Money& new_balance) override;
+    TransferStatus transfer(int from_id, const std::string& to_username, Money amount, Money& new_balance) override;
+    void recordEntry(int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note) override;
+    HistoryPage historyPage(int account_id, long long anchor_id, HistoryDirection dir, int page_size = kHistoryPageSize) override;
+
+private:
+    void noteWrite() {
+        if (reads_) reads_->noteWrite();
+    }
+
+    pqxx::connection& conn_;
+    ReadSession* reads_;
+};
+
+#endif // LEDGER_H
@@ -0,0 +1,367 @@
+// End-to-end load generator: seeds accounts, then runs concurrent simulated
+// clients through the same account/transaction APIs the menus use and reports
+// throughput and latency percentiles per operation.
+//
+// Usage: loadgen.exe [--accounts N] [--clients M] [--duration SECONDS]
+//                    [--mix login=10,deposit=30,withdraw=20,transfer=30,history=9,export=1]
+//                    [--hot K] [--prefix NAME] [--unprepared] [--pipelined N]
+// --hot K sends every balance operation to the first K accounts to measure contention.
+// --pipelined N sends transfers through the async executor on N shared connections.
+#include "account.h"
+#include "account_cache.h"
+#include "async_executor.h"
+#include "database.h"
+#include "login_log.h"
+#include "statements.h"
+#include "transaction.h"
+#include "transfer.h"
+#include "utils.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum Op { OpLogin, OpDeposit, OpWithdraw, OpTransfer, OpHistory, OpExport, OpCount };
+const char* const kOpNames[OpCount] = {"login", "deposit", "withdraw", "transfer", "history", "export"};
+const char* const kPin = "1234";
+const long long kSeedBalanceCents = 100000;
+
+struct Options {
+    size_t accounts = 1000;
+    size_t clients = 8;
+    int duration = 30;
+    int weights[OpCount] = {10, 30, 20, 30, 9, 1};
+    size_t hot = 0;
+    std::string prefix = "lg";
+    size_t pipelined = 0;
+};
+
+struct OpSamples {
+    std::vector<int64_t> latencies_ns;
+    uint64_t rejected = 0;   // insufficient funds, unknown recipient: expected outcomes
+    uint64_t errors = 0;
+};
+
+struct ClientResult {
+    OpSamples ops[OpCount];
+    std::string setup_error;   // set when the client never got to run
+};
+
+struct NullBuffer : std::streambuf {
+    int overflow(int c) override { return c; }
+};
+
+// Per-client directory for OpExport, so clients sharing a --hot account never
+// write the same files; removed when the client stops.
+struct ScratchDir {
+    std::string path;
+
+    explicit ScratchDir(const std::string& name)
+        : path((std::filesystem::temp_directory_path() / name).string()) {
+        // A failure here only makes the exports themselves fail.
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+        std::filesystem::create_directories(path, ec);
+    }
+    ~ScratchDir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path, ec);
+    }
+    ScratchDir(const ScratchDir&) = delete;
+    ScratchDir& operator=(const ScratchDir&) = delete;
+};
+
+bool parseOptions(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--unprepared") {
+            setPreparedStatementsEnabled(false);
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        std::string value = argv[++i];
+        try {
+            if (arg == "--accounts") {
+                opts.accounts = std::stoul(value);
+            } else if (arg == "--clients") {
+                opts.clients = std::stoul(value);
+            } else if (arg == "--duration") {
+                opts.duration = std::stoi(value);
+            } else if (arg == "--hot") {
+                opts.hot = std::stoul(value);
+            } else if (arg == "--pipelined") {
+                opts.pipelined = std::stoul(value);
+            } else if (arg == "--prefix") {
+                opts.prefix = value;
+            } else if (arg == "--mix") {
+                for (int& w : opts.weights) w = 0;
+                std::stringstream ss(value);
+                std::string item;
+                while (std::getline(ss, item, ',')) {
+                    size_t eq = item.find('=');
+                    if (eq == std::string::npos) return false;
+                    std::string name = item.substr(0, eq);
+                    int op = 0;
+                    while (op < OpCount && name != kOpNames[op]) ++op;
+                    if (op == OpCount) return false;
+                    opts.weights[op] = std::stoi(item.substr(eq + 1));
+                }
+            } else {
+                return false;
+            }
+        } catch (...) {
+            return false;
+        }
+    }
+    return opts.accounts >= 2 && opts.clients >= 1 && opts.duration >= 1 && opts.hot != 1;
+}
+
+std::string username(const Options& opts, size_t i) {
+    return opts.prefix + "_" + std::to_string(i + 1);
+}
+
+// Creates any missing load-test accounts, each with a matching InitialDeposit ledger row.
+void seedAccounts(pqxx::connection& conn, const Options& opts) {
+    std::string salt = "loadgen0loadgen0";
+    pqxx::work tx(conn);
+    tx.exec_params(
+        "WITH created AS ("
+        "  INSERT INTO accounts (username, pin_hash, salt, balance) "
+        "  SELECT $1 || '_' || g, $2, $3, $5::int8 * 0.01 FROM generate_series(1, $4) AS g "
+        "  ON CONFLICT (username) DO NOTHING RETURNING id"
+        ") "
+        "INSERT INTO transactions (account_id, kind, amount, counterparty, note) "
+        "SELECT id, $6::int2, $5::int8 * 0.01, '', '' FROM created",
+        opts.prefix, hashPin(kPin, salt), salt, static_cast<long long>(opts.accounts), kSeedBalanceCents,
+        static_cast<int>(TransactionKind::InitialDeposit)
+    );
+    tx.commit();
+}
+
+std::vector<Account> loadAccounts(pqxx::connection& conn, const Options& opts) {
+    std::vector<Account> accounts;
+    accounts.reserve(opts.accounts);
+    for (size_t i = 0; i < opts.accounts; ++i) {
+        Account acc;
+        if (!fetchAccountByUsername(conn, username(opts, i), acc)) {
+            throw std::runtime_error("Seeded account missing: " + username(opts, i));
+        }
+        accounts.push_back(acc);
+    }
+    return accounts;
+}
+
+TransferStatus transferPipelined(AsyncExecutor& exec, int from_id, const std::string& to_username, Money amount) {
+    std::promise<AsyncTransferResult> done;
+    std::future<AsyncTransferResult> result = done.get_future();
+    transferFundsAsync(exec, from_id, to_username, amount, [&done](const AsyncTransferResult& r) {
+        done.set_value(r);
+    });
+    AsyncTransferResult r = result.get();
+    if (!r.error.empty()) throw std::runtime_error(r.error);
+    return r.status;
+}
+
+void runOps(Database::Lease& conn, const std::string& exportDir, LoginLogWriter& loginLog, AsyncExecutor* exec,
+            const Options& opts, const std::vector<Account>& accounts, std::chrono::steady_clock::time_point deadline,
+            unsigned seed, ClientResult& out) {
+    std::mt19937 gen(seed);
+    size_t pool = opts.hot > 0 ? std::min(opts.hot, accounts.size()) : accounts.size();
+    std::uniform_int_distribution<size_t> pickAccount(0, pool - 1);
+    std::uniform_int_distribution<int64_t> pickCents(100, 2000);
+    std::discrete_distribution<int> pickOp(std::begin(opts.weights), std::end(opts.weights));
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        int op = pickOp(gen);
+        const Account& acc = accounts[pickAccount(gen)];
+        Money amount = Money::fromCents(pickCents(gen));
+        bool rejected = false;
+
+        auto start = std::chrono::steady_clock::now();
+        try {
+            Money balance;
+            switch (op) {
+                case OpLogin: {
+                    LoginResult login = authenticate(*conn, acc.username, kPin, nowSeconds());
+                    loginLog.record(login.account.id, login.status == LoginStatus::Ok);
+                    rejected = login.status != LoginStatus::Ok;
+                    break;
+                }
+                case OpDeposit:
+                    depositFunds(*conn, acc.id, amount, balance);
+                    break;
+                case OpWithdraw:
+                    rejected = !withdrawFunds(*conn, acc.id, amount, balance);
+                    break;
+                case OpTransfer: {
+                    const Account* to = &accounts[pickAccount(gen)];
+                    while (to->id == acc.id) to = &accounts[pickAccount(gen)];
+                    TransferStatus status = exec ? transferPipelined(*exec, acc.id, to->username, amount)
+                                                 : transferFunds(*conn, acc.id, to->username, amount, balance);
+                    rejected = status != TransferStatus::Ok;
+                    break;
+                }
+                case OpHistory:
+                    fetchHistoryPage(*conn, acc.id, 0, HistoryDirection::Older);
+                    break;
+                case OpExport:
+                    exportHistory(*conn, acc, ReadRoute(), exportDir);
+                    break;
+            }
+        } catch (const pqxx::broken_connection&) {
+            out.ops[op].errors += 1;
+            conn.markBroken();
+            return;
+        } catch (const std::exception&) {
+            out.ops[op].errors += 1;
+            continue;
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        out.ops[op].latencies_ns.push_back(ns);
+        if (rejected) out.ops[op].rejected += 1;
+    }
+}
+
+// Runs on its own thread: a client that cannot get a connection or its export
+// directory is reported instead of taking the process down.
+void runClient(Database& db, LoginLogWriter& loginLog, AsyncExecutor* exec, const Options& opts, const std::vector<Account>& accounts,
+               std::chrono::steady_clock::time_point deadline, unsigned seed, ClientResult& out) {
+    try {
+        Database::Lease conn = db.acquire();
+        ScratchDir exportDir("bank_loadgen_" + opts.prefix + "_" + std::to_string(seed));
+        runOps(conn, exportDir.path, loginLog, exec, opts, accounts, deadline, seed, out);
+    } catch (const std::exception& ex) {
+        out.setup_error = ex.what();
+    }
+}
+
+double percentileMs(const std::vector<int64_t>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t idx = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return static_cast<double>(sorted[idx]) / 1e6;
+}
+
+void printReport(const Options& opts, std::vector<ClientResult>& results, double seconds) {
+    std::cout << "\n" << opts.clients << " clients, " << opts.accounts << " accounts";
+    if (opts.hot > 0) std::cout << " (" << opts.hot << " hot)";
+    std::cout << ", " << std::fixed << std::setprecision(1) << seconds << " s, "
+              << (preparedStatementsEnabled() ? "prepared" : "unprepared") << " statements";
+    if (opts.pipelined > 0) std::cout << ", transfers pipelined on " << opts.pipelined << " connection(s)";
+    std::cout << "\n";
+
+    size_t failedClients = 0;
+    std::string firstError;
+    for (const auto& r : results) {
+        if (r.setup_error.empty()) continue;
+        if (failedClients++ == 0) firstError = r.setup_error;
+    }
+    if (failedClients > 0) {
+        std::cout << failedClients << " client(s) failed to start: " << firstError << "\n";
+    }
+    std::cout << "\n";
+
+    std::cout << std::left << std::setw(10) << "op" << std::right
+              << std::setw(10) << "count" << std::setw(10) << "ops/s" << std::setw(10) << "rejected" << std::setw(8) << "errors"
+              << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p99.9 ms" << "\n";
+
+    uint64_t total = 0;
+    for (int op = 0; op < OpCount; ++op) {
+        std::vector<int64_t> all;
+        uint64_t rejected = 0;
+        uint64_t errors = 0;
+        for (auto& r : results) {
+            all.insert(all.end(), r.ops[op].latencies_ns.begin(), r.ops[op].latencies_ns.end());
+            rejected += r.ops[op].rejected;
+            errors += r.ops[op].errors;
+        }
+        if (all.empty() && errors == 0) continue;
+        std::sort(all.begin(), all.end());
+        total += all.size();
+
+        std::cout << std::left << std::setw(10) << kOpNames[op] << std::right
+                  << std::setw(10) << all.size() << std::setw(10) << std::setprecision(0) << all.size() / seconds
+                  << std::setw(10) << rejected << std::setw(8) << errors << std::setprecision(2)
+                  << std::setw(10) << percentileMs(all, 0.50) << std::setw(10) << percentileMs(all, 0.95)
+                  << std::setw(10) << percentileMs(all, 0.99) << std::setw(10) << percentileMs(all, 0.999) << "\n";
+    }
+    std::cout << "\nTotal: " << total << " ops, " << std::setprecision(0) << total / seconds << " ops/s\n";
+
+    TransferStats ts = transferStats();
+    std::cout << "Transfers: " << ts.committed << " committed, " << ts.retries << " retries, " << ts.aborted << " aborted\n";
+
+    AccountCacheStats cs = accountCache().stats();
+    std::cout << "Account cache: " << cs.hits << " hits, " << cs.misses << " misses, " << cs.invalidations << " invalidations\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    if (!parseOptions(argc, argv, opts)) {
+        std::cout << "Usage: loadgen.exe [--accounts N] [--clients M] [--duration SECONDS]\n"
+                     "                   [--mix login=10,deposit=30,withdraw=20,transfer=30,history=9,export=1]\n"
+                     "                   [--hot K (K >= 2)] [--prefix NAME] [--unprepared] [--pipelined N]\n";
+        return 1;
+    }
+
+    const char* connStr = std::getenv("NEON_DATABASE_URL");
+    if (!connStr || std::string(connStr).empty()) {
+        std::cout << "Missing NEON_DATABASE_URL environment variable (point it at a local Postgres).\n";
+        return 1;
+    }
+
+    try {
+        // One connection per client, plus one for the login log writer.
+        Database db(connStr, opts.clients + 1);
+        db.ensureSchema();
+
+        std::vector<Account> accounts;
+        {
+            Database::Lease conn = db.acquire();
+            std::cout << "Seeding " << opts.accounts << " accounts (prefix " << opts.prefix << ")...\n";
+            seedAccounts(*conn, opts);
+            accounts = loadAccounts(*conn, opts);
+        }
+
+        LoginLogWriter loginLog(db);
+        std::unique_ptr<AsyncExecutor> exec;
+        if (opts.pipelined > 0) exec.reset(new AsyncExecutor(connStr, opts.pipelined));
+        std::vector<ClientResult> results(opts.clients);
+        std::vector<std::thread> clients;
+
+        // exportHistory reports to stdout; keep the report readable.
+        NullBuffer discard;
+        std::streambuf* saved = std::cout.rdbuf(&discard);
+
+        auto started = std::chrono::steady_clock::now();
+        auto deadline = started + std::chrono::seconds(opts.duration);
+        for (size_t i = 0; i < opts.clients; ++i) {
+            clients.emplace_back(runClient, std::ref(db), std::ref(loginLog), exec.get(), std::cref(opts), std::cref(accounts),
+                                 deadline, static_cast<unsigned>(i + 1), std::ref(results[i]));
+        }
+        for (auto& t : clients) t.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        std::cout.rdbuf(saved);
+        loginLog.stop();
+        printReport(opts, results, seconds);
+    } catch (const std::exception& ex) {
+        std::cout << "Database error: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
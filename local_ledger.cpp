@@ -0,0 +1,567 @@
+#include "local_ledger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Journal record types. Each change is one record, replayed by apply().
+enum RecordType : uint8_t {
+    kAccountCreated = 1,   // id, username, pin_hash, salt, initial cents, created_us
+    kPosted = 2,           // account_id, type, amount, balance delta, counterparty, note, created_us
+    kTransferred = 3,      // from_id, to_id, amount, created_us
+    kLoginState = 4,       // account_id, failed_attempts, locked_until
+};
+
+const char kSnapshotMagic[8] = {'B', 'A', 'N', 'K', 'S', 'N', 'P', '1'};
+
+class Encoder {
+public:
+    Encoder() = default;
+    explicit Encoder(RecordType type) { out_.push_back(static_cast<char>(type)); }
+
+    void raw(const void* p, size_t n) { out_.append(static_cast<const char*>(p), n); }
+    void i32(int32_t v) { raw(&v, sizeof v); }
+    void i64(int64_t v) { raw(&v, sizeof v); }
+    void u64(uint64_t v) { raw(&v, sizeof v); }
+    void str(const std::string& s) {
+        uint32_t len = static_cast<uint32_t>(s.size());
+        raw(&len, sizeof len);
+        out_.append(s);
+    }
+
+    const std::string& data() const { return out_; }
+
+private:
+    std::string out_;
+};
+
+class Decoder {
+public:
+    explicit Decoder(std::string_view in) : in_(in) {}
+
+    uint8_t u8() { return fixed<uint8_t>(); }
+    int32_t i32() { return fixed<int32_t>(); }
+    int64_t i64() { return fixed<int64_t>(); }
+    uint64_t u64() { return fixed<uint64_t>(); }
+    std::string str() {
+        uint32_t len = fixed<uint32_t>();
+        need(len);
+        std::string s(in_.substr(pos_, len));
+        pos_ += len;
+        return s;
+    }
+
+private:
+    void need(size_t n) const {
+        if (in_.size() - pos_ < n) throw std::runtime_error("Truncated local ledger record");
+    }
+    template <typename T>
+    T fixed() {
+        need(sizeof(T));
+        T v;
+        std::memcpy(&v, in_.data() + pos_, sizeof v);
+        pos_ += sizeof v;
+        return v;
+    }
+
+    std::string_view in_;
+    size_t pos_ = 0;
+};
+
+int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Same shape as a timestamptz rendered in a UTC session.
+std::string formatTimestamp(int64_t us) {
+    std::time_t secs = static_cast<std::time_t>(us / 1000000);
+    std::tm tm{};
+#if defined(_WIN32)
+    gmtime_s(&tm, &secs);
+#else
+    gmtime_r(&secs, &tm);
+#endif
+    char buf[32];
+    std::strftime(buf, sizeof buf, "%Y-%m-%d %H:%M:%S+00", &tm);
+    return buf;
+}
+
+std::string postedRecord(int account_id, TransactionKind kind, int64_t amount, int64_t delta,
+                         const std::string& counterparty, const std::string& note) {
+    Encoder rec(kPosted);
+    rec.i32(account_id);
+    rec.str(transactionKindName(kind));
+    rec.i64(amount);
+    rec.i64(delta);
+    rec.str(counterparty);
+    rec.str(note);
+    rec.i64(nowMicros());
+    return rec.data();
+}
+
+// Kinds are journaled by name, so records stay readable if codes are ever renumbered.
+TransactionKind decodeKind(const std::string& name) {
+    TransactionKind kind;
+    if (!transactionKindFromName(name, kind)) throw std::runtime_error("Unknown transaction kind in local ledger: " + name);
+    return kind;
+}
+
+std::string loginRecord(int account_id, int failed_attempts, long long locked_until) {
+    Encoder rec(kLoginState);
+    rec.i32(account_id);
+    rec.i32(failed_attempts);
+    rec.i64(locked_until);
+    return rec.data();
+}
+
+// Write to a temporary file, fsync, rename over path and fsync the directory,
+// so a crash leaves either the old snapshot or the new one.
+void writeFileAtomically(const std::string& path, const std::string& data, bool fsync) {
+#if !defined(_WIN32)
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot create " + tmp + " (" + std::strerror(errno) + ")");
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot write " + tmp + " (" + std::strerror(errno) + ")");
+        }
+        written += static_cast<size_t>(n);
+    }
+    if (fsync && ::fsync(fd) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot sync " + tmp + " (" + std::strerror(errno) + ")");
+    }
+    ::close(fd);
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot rename " + tmp + " (" + std::strerror(errno) + ")");
+    }
+    if (fsync) {
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+        int dfd = ::open(dir.c_str(), O_RDONLY);
+        if (dfd >= 0) {
+            ::fsync(dfd);
+            ::close(dfd);
+        }
+    }
+#else
+    (void)path; (void)data; (void)fsync;
+    throw std::runtime_error("The local ledger needs a POSIX system");
+#endif
+}
+
+} // namespace
+
+LocalLedger::LocalLedger(const std::string& path, LocalLedgerOptions options)
+    : path_(path), options_(options), journal_(path, options.fsync) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loadSnapshot();
+
+    uint64_t generation = journal_.generation();
+    if (snapshotGeneration_ == generation || (snapshotGeneration_ == 0 && generation == 1)) {
+        stats_.replayed = journal_.replay([this](std::string_view record) { apply(record); });
+        sinceSnapshot_ = stats_.replayed;
+    } else if (snapshotGeneration_ == generation + 1) {
+        // The last snapshot was written but the journal was never emptied:
+        // its records are already in the snapshot.
+        journal_.reset(snapshotGeneration_);
+    } else if (journal_.fresh()) {
+        // Missing or never-written journal next to a snapshot: nothing was
+        // journaled after it.
+        journal_.reset(snapshotGeneration_);
+    } else {
+        throw std::runtime_error("Local ledger " + path_ + ": journal generation " + std::to_string(generation) +
+                                 " does not match snapshot generation " + std::to_string(snapshotGeneration_));
+    }
+}
+
+LocalLedger::~LocalLedger() {
+    try {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (sinceSnapshot_ > 0) snapshotLocked();
+    } catch (...) {
+        // The journal still holds everything; the next open replays it.
+    }
+}
+
+const char* LocalLedger::name() const {
+    return "Local";
+}
+
+LocalLedger::AccountState* LocalLedger::find(int id) {
+    if (id <= 0 || static_cast<size_t>(id) > accounts_.size()) return nullptr;
+    return &accounts_[static_cast<size_t>(id) - 1];
+}
+
+uint64_t LocalLedger::commit(const std::string& record) {
+    uint64_t lsn = journal_.append(record);
+    apply(record);
+    sinceSnapshot_ += 1;
+    sinceSnapshotBytes_ += record.size();
+    if ((options_.snapshot_every > 0 && sinceSnapshot_ >= options_.snapshot_every) ||
+        sinceSnapshotBytes_ >= Journal::kMaxBytes / 2) {
+        snapshotLocked();
+    }
+    return lsn;
+}
+
+void LocalLedger::addEntry(AccountState& state, TransactionKind kind, int64_t amount_cents,
+                           const std::string& counterparty, const std::string& note, int64_t created_us) {
+    state.entries.push_back(Entry{nextEntryId_++, kind, amount_cents, counterparty, note, created_us});
+    entryCount_ += 1;
+}
+
+void LocalLedger::apply(std::string_view record) {
+    Decoder in(record);
+    switch (in.u8()) {
+    case kAccountCreated: {
+        AccountState state;
+        state.account.id = in.i32();
+        state.account.username = in.str();
+        state.account.pin_hash = in.str();
+        state.account.salt = in.str();
+        int64_t initial = in.i64();
+        int64_t created_us = in.i64();
+        if (static_cast<size_t>(state.account.id) != accounts_.size() + 1) {
+            throw std::runtime_error("Local ledger record out of order");
+        }
+        state.account.balance = Money::fromCents(initial);
+        if (initial > 0) addEntry(state, TransactionKind::InitialDeposit, initial, "", "", created_us);
+        byUsername_[state.account.username] = state.account.id;
+        accounts_.push_back(std::move(state));
+        break;
+    }
+    case kPosted: {
+        AccountState* state = find(in.i32());
+        if (!state) throw std::runtime_error("Local ledger record for unknown account");
+        TransactionKind kind = decodeKind(in.str());
+        int64_t amount = in.i64();
+        int64_t delta = in.i64();
+        std::string counterparty = in.str();
+        std::string note = in.str();
+        state->account.balance += Money::fromCents(delta);
+        addEntry(*state, kind, amount, counterparty, note, in.i64());
+        break;
+    }
+    case kTransferred: {
+        AccountState* from = find(in.i32());
+        AccountState* to = find(in.i32());
+        if (!from || !to) throw std::runtime_error("Local ledger record for unknown account");
+        int64_t amount = in.i64();
+        int64_t created_us = in.i64();
+        from->account.balance -= Money::fromCents(amount);
+        to->account.balance += Money::fromCents(amount);
+        addEntry(*from, TransactionKind::TransferOut, amount, to->account.username, "", created_us);
+        addEntry(*to, TransactionKind::TransferIn, amount, from->account.username, "", created_us);
+        break;
+    }
+    case kLoginState: {
+        AccountState* state = find(in.i32());
+        if (!state) throw std::runtime_error("Local ledger record for unknown account");
+        state->account.failed_attempts = in.i32();
+        state->account.locked_until = in.i64();
+        break;
+    }
+    default:
+        throw std::runtime_error("Unknown local ledger record type");
+    }
+}
+
+bool LocalLedger::fetchAccountByUsername(const std::string& username, Account& out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = byUsername_.find(username);
+    if (it == byUsername_.end()) return false;
+    out = accounts_[static_cast<size_t>(it->second) - 1].account;
+    return true;
+}
+
+int LocalLedger::createAccount(const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance) {
+    int id;
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (byUsername_.count(username)) return 0;
+        id = static_cast<int>(accounts_.size()) + 1;
+        Encoder rec(kAccountCreated);
+        rec.i32(id);
+        rec.str(username);
+        rec.str(pin_hash);
+        rec.str(salt);
+        rec.i64(initial_balance.cents());
+        rec.i64(nowMicros());
+        lsn = commit(rec.data());
+    }
+    journal_.sync(lsn);
+    return id;
+}
+
+LoginResult LocalLedger::authenticate(const std::string& username, const std::string& pin, long long now) {
+    LoginResult result;
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = byUsername_.find(username);
+        if (it == byUsername_.end()) {
+            result.status = LoginStatus::UnknownUser;
+            return result;
+        }
+
+        Account& acc = result.account;
+        acc = accounts_[static_cast<size_t>(it->second) - 1].account;
+        if (acc.locked_until > now) {
+            result.status = LoginStatus::Locked;
+            result.lock_remaining = acc.locked_until - now;
+            return result;
+        }
+
+        if (acc.pin_hash != hashPin(pin, acc.salt)) {
+            // Same rule as RecordFailedLogin: the last allowed miss locks and resets the count.
+            int failed = acc.failed_attempts + 1;
+            long long locked_until = acc.locked_until;
+            if (failed >= kMaxFailedAttempts) {
+                failed = 0;
+                locked_until = now + kLockSeconds;
+            }
+            lsn = commit(loginRecord(acc.id, failed, locked_until));
+            acc.failed_attempts = failed;
+            acc.locked_until = locked_until;
+            if (acc.locked_until > now) {
+                result.status = LoginStatus::LockedOut;
+            } else {
+                result.status = LoginStatus::BadPin;
+                result.attempts_left = kMaxFailedAttempts - acc.failed_attempts;
+            }
+        } else {
+            if (acc.failed_attempts != 0 || acc.locked_until != 0) {
+                lsn = commit(loginRecord(acc.id, 0, 0));
+                acc.failed_attempts = 0;
+                acc.locked_until = 0;
+            }
+            result.status = LoginStatus::Ok;
+        }
+    }
+    if (lsn) journal_.sync(lsn);
+    return result;
+}
+
+void LocalLedger::deposit(int account_id, Money amount, Money& new_balance) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        AccountState* state = find(account_id);
+        if (!state) throw std::runtime_error("Account not found");
+        Money balance = state->account.balance + amount;   // throws before anything is journaled
+        lsn = commit(postedRecord(account_id, TransactionKind::Deposit, amount.cents(), amount.cents(), "", ""));
+        new_balance = balance;
+    }
+    journal_.sync(lsn);
+}
+
+bool LocalLedger::withdraw(int account_id, Money amount, Money& new_balance) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        AccountState* state = find(account_id);
+        if (!state) throw std::runtime_error("Account not found");
+        if (state->account.balance < amount) return false;
+        lsn = commit(postedRecord(account_id, TransactionKind::Withdraw, amount.cents(), -amount.cents(), "", ""));
+        new_balance = find(account_id)->account.balance;
+    }
+    journal_.sync(lsn);
+    return true;
+}
+
+TransferStatus LocalLedger::transfer(int from_id, const std::string& to_username, Money amount, Money& new_balance) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        AccountState* from = find(from_id);
+        if (!from) throw std::runtime_error("Account not found");
+        auto it = byUsername_.find(to_username);
+        if (it == byUsername_.end() || it->second == from_id) return TransferStatus::RecipientNotFound;
+        if (from->account.balance < amount) return TransferStatus::InsufficientFunds;
+        (void)(find(it->second)->account.balance + amount);   // overflow check before journaling
+
+        Encoder rec(kTransferred);
+        rec.i32(from_id);
+        rec.i32(it->second);
+        rec.i64(amount.cents());
+        rec.i64(nowMicros());
+        lsn = commit(rec.data());
+        new_balance = find(from_id)->account.balance;
+    }
+    journal_.sync(lsn);
+    return TransferStatus::Ok;
+}
+
+void LocalLedger::recordEntry(int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note) {
+    uint64_t lsn;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!find(account_id)) throw std::runtime_error("Account not found");
+        lsn = commit(postedRecord(account_id, kind, amount.cents(), 0, counterparty, note));
+    }
+    journal_.sync(lsn);
+}
+
+HistoryPage LocalLedger::historyPage(int account_id, long long anchor_id, HistoryDirection dir, int page_size) {
+    HistoryPage page;
+    std::vector<const Entry*> rows;
+    size_t limit = static_cast<size_t>(page_size) + 1;   // one extra says whether another page exists
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    AccountState* state = find(account_id);
+    if (!state) return page;
+    const std::vector<Entry>& entries = state->entries;
+    auto byId = [](const Entry& e, long long id) { return e.id < id; };
+
+    if (dir == HistoryDirection::Older) {
+        long long before = anchor_id > 0 ? anchor_id : std::numeric_limits<long long>::max();
+        auto end = std::lower_bound(entries.begin(), entries.end(), before, byId);
+        for (auto it = end; it != entries.begin() && rows.size() < limit;) rows.push_back(&*--it);
+    } else {
+        auto begin = std::lower_bound(entries.begin(), entries.end(), anchor_id + 1, byId);
+        for (auto it = begin; it != entries.end() && rows.size() < limit; ++it) rows.push_back(&*it);
+    }
+
+    bool more = rows.size() > static_cast<size_t>(page_size);
+    size_t count = more ? static_cast<size_t>(page_size) : rows.size();
+    page.entries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        HistoryEntry e;
+        e.id = rows[i]->id;
+        e.kind = rows[i]->kind;
+        e.amount = Money::fromCents(rows[i]->amount_cents);
+        e.counterparty = rows[i]->counterparty;
+        e.note = rows[i]->note;
+        e.created_at = formatTimestamp(rows[i]->created_us);
+        page.entries.push_back(std::move(e));
+    }
+
+    if (dir == HistoryDirection::Older) {
+        page.has_older = more;
+        page.has_newer = anchor_id > 0;
+    } else {
+        std::reverse(page.entries.begin(), page.entries.end());
+        page.has_newer = more;
+        page.has_older = true;
+    }
+    return page;
+}
+
+void LocalLedger::snapshot() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshotLocked();
+}
+
+LocalLedgerStats LocalLedger::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LocalLedgerStats out = stats_;
+    out.accounts = accounts_.size();
+    out.entries = entryCount_;
+    out.journal = journal_.stats();
+    return out;
+}
+
+// Layout: magic, u64 generation, i64 next entry id, i32 account count, then
+// per account its fields and entries; a trailing fnv1a64 covers all of it.
+void LocalLedger::snapshotLocked() {
+    uint64_t generation = journal_.generation() + 1;
+
+    Encoder out;
+    out.raw(kSnapshotMagic, sizeof kSnapshotMagic);
+    out.u64(generation);
+    out.i64(nextEntryId_);
+    out.i32(static_cast<int32_t>(accounts_.size()));
+    for (const AccountState& state : accounts_) {
+        const Account& acc = state.account;
+        out.str(acc.username);
+        out.str(acc.pin_hash);
+        out.str(acc.salt);
+        out.i64(acc.balance.cents());
+        out.i32(acc.failed_attempts);
+        out.i64(acc.locked_until);
+        out.i64(static_cast<int64_t>(state.entries.size()));
+        for (const Entry& e : state.entries) {
+            out.i64(e.id);
+            out.str(transactionKindName(e.kind));
+            out.i64(e.amount_cents);
+            out.str(e.counterparty);
+            out.str(e.note);
+            out.i64(e.created_us);
+        }
+    }
+    out.u64(fnv1a64(out.data()));
+
+    writeFileAtomically(path_ + ".snap", out.data(), options_.fsync);
+    journal_.reset(generation);
+    snapshotGeneration_ = generation;
+    sinceSnapshot_ = 0;
+    sinceSnapshotBytes_ = 0;
+    stats_.snapshots += 1;
+}
+
+void LocalLedger::loadSnapshot() {
+    std::ifstream in(path_ + ".snap", std::ios::binary);
+    if (!in) return;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    const std::string bad = "Local ledger snapshot " + path_ + ".snap is corrupt";
+    if (data.size() < sizeof kSnapshotMagic + 16 || std::memcmp(data.data(), kSnapshotMagic, sizeof kSnapshotMagic) != 0) {
+        throw std::runtime_error(bad);
+    }
+    std::string_view body(data.data(), data.size() - 8);
+    uint64_t checksum;
+    std::memcpy(&checksum, data.data() + body.size(), sizeof checksum);
+    if (fnv1a64(body) != checksum) throw std::runtime_error(bad);
+
+    Decoder d(body.substr(sizeof kSnapshotMagic));
+    uint64_t generation = d.u64();
+    nextEntryId_ = d.i64();
+    int32_t count = d.i32();
+    accounts_.reserve(static_cast<size_t>(count));
+    for (int32_t i = 0; i < count; ++i) {
+        AccountState state;
+        Account& acc = state.account;
+        acc.id = i + 1;
+        acc.username = d.str();
+        acc.pin_hash = d.str();
+        acc.salt = d.str();
+        acc.balance = Money::fromCents(d.i64());
+        acc.failed_attempts = d.i32();
+        acc.locked_until = d.i64();
+        int64_t entries = d.i64();
+        state.entries.reserve(static_cast<size_t>(entries));
+        for (int64_t j = 0; j < entries; ++j) {
+            Entry e;
+            e.id = d.i64();
+            e.kind = decodeKind(d.str());
+            e.amount_cents = d.i64();
+            e.counterparty = d.str();
+            e.note = d.str();
+            e.created_us = d.i64();
+            state.entries.push_back(std::move(e));
+        }
+        entryCount_ += static_cast<uint64_t>(entries);
+        byUsername_[acc.username] = acc.id;
+        accounts_.push_back(std::move(state));
+    }
+    snapshotGeneration_ = generation;
+}
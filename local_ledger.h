@@ -0,0 +1,95 @@
+#ifndef LOCAL_LEDGER_H
+#define LOCAL_LEDGER_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "journal.h"
+#include "ledger.h"
+
+struct LocalLedgerOptions {
+    bool fsync = true;                 // false: a commit returns once its record is in the page cache
+    uint64_t snapshot_every = 100000;  // journal records between automatic snapshots (0 = only on close)
+};
+
+struct LocalLedgerStats {
+    size_t accounts = 0;
+    uint64_t entries = 0;
+    uint64_t replayed = 0;             // journal records applied at open
+    uint64_t snapshots = 0;
+    JournalStats journal;
+};
+
+// In-process ledger for offline/edge use and latency benchmarks. All state
+// lives in memory: accounts indexed by id and username, each with its ledger
+// rows in id order. Every change is one journal record, appended and applied
+// under one lock, and the caller waits for the journal's group commit.
+//
+// On open the state is rebuilt from <path>.snap (if any) plus the journal
+// records written after it. Snapshots are written to a temporary file and
+// renamed, then the journal is emptied; the journal generation stored in both
+// tells a crash between those two steps apart from a normal restart.
+class LocalLedger : public Ledger {
+public:
+    explicit LocalLedger(const std::string& path, LocalLedgerOptions options = LocalLedgerOptions());
+    // Writes a final snapshot so the next open replays nothing.
+    ~LocalLedger() override;
+
+    const char* name() const override;
+    bool fetchAccountByUsername(const std::string& username, Account& out) override;
+    int createAccount(const std::string& username, const std::string& pin_hash, const std::string& salt, Money initial_balance) override;
+    LoginResult authenticate(const std::string& username, const std::string& pin, long long now) override;
+    void deposit(int account_id, Money amount, Money& new_balance) override;
+    bool withdraw(int account_id, Money amount, Money& new_balance) override;
+    TransferStatus transfer(int from_id, const std::string& to_username, Money amount, Money& new_balance) override;
+    void recordEntry(int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note) override;
+    HistoryPage historyPage(int account_id, long long anchor_id, HistoryDirection dir, int page_size = kHistoryPageSize) override;
+
+    void snapshot();
+    LocalLedgerStats stats() const;
+
+private:
+    struct Entry {
+        long long id;
+        TransactionKind kind;
+        int64_t amount_cents;
+        std::string counterparty;
+        std::string note;
+        int64_t created_us;
+    };
+
+    struct AccountState {
+        Account account;
+        std::vector<Entry> entries;    // ascending id
+    };
+
+    AccountState* find(int id);
+    // Appends the record and applies it, snapshotting when a threshold is
+    // reached; caller holds mutex_. Returns the LSN to sync after unlocking.
+    uint64_t commit(const std::string& record);
+    void apply(std::string_view record);
+    void addEntry(AccountState& state, TransactionKind kind, int64_t amount_cents,
+                  const std::string& counterparty, const std::string& note, int64_t created_us);
+    void snapshotLocked();
+    void loadSnapshot();
+
+    std::string path_;
+    LocalLedgerOptions options_;
+    Journal journal_;
+
+    mutable std::mutex mutex_;
+    std::vector<AccountState> accounts_;   // id - 1
+    std::unordered_map<std::string, int> byUsername_;
+    long long nextEntryId_ = 1;
+    uint64_t entryCount_ = 0;
+    uint64_t sinceSnapshot_ = 0;           // records
+    uint64_t sinceSnapshotBytes_ = 0;
+    uint64_t snapshotGeneration_ = 0;      // 0: no snapshot on disk
+    LocalLedgerStats stats_;
+};
+
+#endif // LOCAL_LEDGER_H
@@ -0,0 +1,120 @@
+#include "login_log.h"
+#include "statements.h"
+#include <iostream>
+#include <string>
+
+namespace {
+const std::chrono::milliseconds kFlushInterval(500);
+const int kMaxWriteAttempts = 3;
+}
+
+LoginLogWriter::LoginLogWriter(Database& db) : db_(db) {
+    worker_ = std::thread(&LoginLogWriter::run, this);
+}
+
+LoginLogWriter::~LoginLogWriter() {
+    stop();
+}
+
+void LoginLogWriter::record(int account_id, bool success) {
+    long long now_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= kCapacity) {
+        wake_.notify_one();
+        space_.wait(lock, [this] { return queue_.size() < kCapacity || stopping_; });
+    }
+    queue_.push_back(Entry{account_id, success, now_us});
+    stats_.recorded += 1;
+    if (queue_.size() >= kBatchSize) wake_.notify_one();
+}
+
+void LoginLogWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    space_.notify_all();
+    if (worker_.joinable()) worker_.join();
+}
+
+LoginLogStats LoginLogWriter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void LoginLogWriter::run() {
+    std::vector<Entry> batch;
+    batch.reserve(kBatchSize);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait_for(lock, kFlushInterval, [this] { return stopping_ || queue_.size() >= kBatchSize; });
+            if (queue_.empty()) {
+                if (stopping_) return;
+                continue;
+            }
+            while (!queue_.empty() && batch.size() < kBatchSize) {
+                batch.push_back(queue_.front());
+                queue_.pop_front();
+            }
+        }
+        space_.notify_all();
+
+        bool written = false;
+        for (int attempt = 0; attempt < kMaxWriteAttempts && !written; ++attempt) {
+            written = writeBatch(batch);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (written) {
+                stats_.written += batch.size();
+                stats_.batches += 1;
+            } else {
+                stats_.dropped += batch.size();
+            }
+        }
+        if (!written) {
+            std::cerr << "login_logs: dropped " << batch.size() << " rows after repeated write failures.\n";
+        }
+        batch.clear();
+    }
+}
+
+bool LoginLogWriter::writeBatch(const std::vector<Entry>& batch) {
+    std::string ids = "{";
+    std::string successes = "{";
+    std::string times = "{";
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (i > 0) {
+            ids += ',';
+            successes += ',';
+            times += ',';
+        }
+        ids += std::to_string(batch[i].account_id);
+        successes += batch[i].success ? 't' : 'f';
+        times += std::to_string(batch[i].time_us);
+    }
+    ids += '}';
+    successes += '}';
+    times += '}';
+
+    try {
+        Database::Lease conn = db_.acquire();
+        try {
+            pqxx::nontransaction tx(*conn);
+            execStatement(tx, stmt::LogLoginBatch, ids, successes, times);
+        } catch (const pqxx::broken_connection&) {
+            conn.markBroken();
+            throw;
+        }
+        return true;
+    } catch (const std::exception& ex) {
+        std::cerr << "login_logs: write failed: " << ex.what() << "\n";
+        return false;
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef LOGIN_LOG_H
+#define LOGIN_LOG_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "database.h"
+
+struct LoginLogStats {
+    uint64_t recorded = 0;
+    uint64_t written = 0;
+    uint64_t batches = 0;
+    uint64_t dropped = 0;    // rows given up on after repeated write failures
+};
+
+// Buffers login_logs rows in a bounded in-process queue and writes them in
+// multi-row INSERTs from a background thread, when kBatchSize rows are waiting
+// or kFlushInterval has passed. record() only blocks when the queue is full.
+// stop() (also run by the destructor) writes everything still queued.
+class LoginLogWriter {
+public:
+    static const size_t kCapacity = 8192;
+    static const size_t kBatchSize = 500;
+
+    explicit LoginLogWriter(Database& db);
+    ~LoginLogWriter();
+
+    LoginLogWriter(const LoginLogWriter&) = delete;
+    LoginLogWriter& operator=(const LoginLogWriter&) = delete;
+
+    void record(int account_id, bool success);
+    void stop();
+    LoginLogStats stats() const;
+
+private:
+    struct Entry {
+        int account_id;
+        bool success;
+        long long time_us;
+    };
+
+    void run();
+    bool writeBatch(const std::vector<Entry>& batch);
+
+    Database& db_;
+    std::deque<Entry> queue_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable space_;
+    bool stopping_ = false;
+    LoginLogStats stats_;
+    std::thread worker_;
+};
+
+#endif // LOGIN_LOG_H
@@ -1,24 +1,407 @@
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <memory>
 #include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
 #include <pqxx/pqxx>
+#include "account_cache.h"
+#include "async_executor.h"
+#include "batch_statements.h"
+#include "client.h"
 #include "database.h"
+#include "ingest.h"
+#include "job_scheduler.h"
+#include "local_ledger.h"
+#include "login_log.h"
+#include "metrics.h"
+#include "migrations.h"
+#include "partitions.h"
+#include "reconcile.h"
+#include "replica.h"
+#include "server.h"
+#include "statements.h"
+#include "transaction.h"
 #include "ui.h"
+#include "utils.h"
+
+// The interactive session and the login log writer hold a connection each, and
+// every running background job leases one; main() raises this to cover them.
+static size_t poolSizeFromEnv() {
+    const char* raw = std::getenv("DB_POOL_SIZE");
+    if (!raw || std::string(raw).empty()) return Database::kDefaultPoolSize;
+    try {
+        long v = std::stol(raw);
+        if (v >= 2) return static_cast<size_t>(v);
+    } catch (...) {
+    }
+    std::cout << "Ignoring invalid DB_POOL_SIZE; using " << Database::kDefaultPoolSize << ".\n";
+    return Database::kDefaultPoolSize;
+}
+
+// ACCOUNT_CACHE_SIZE sets how many account rows are cached in-process (0 turns the cache off).
+static void configureAccountCacheFromEnv() {
+    const char* raw = std::getenv("ACCOUNT_CACHE_SIZE");
+    if (!raw || std::string(raw).empty()) return;
+    try {
+        size_t idx = 0;
+        long v = std::stol(raw, &idx);
+        if (idx == std::string(raw).size() && v >= 0) {
+            accountCache().setCapacity(static_cast<size_t>(v));
+            return;
+        }
+    } catch (...) {
+    }
+    std::cout << "Ignoring invalid ACCOUNT_CACHE_SIZE; using " << AccountCache::kDefaultCapacity << ".\n";
+}
+
+// ACCOUNT_CACHE_NOTIFY=1 keeps the cache coherent with other instances (see AccountCacheListener).
+static std::unique_ptr<AccountCacheListener> accountCacheListenerFromEnv(const char* connStr) {
+    const char* raw = std::getenv("ACCOUNT_CACHE_NOTIFY");
+    if (!raw || std::string(raw) != "1" || !accountCache().enabled()) return nullptr;
+    return std::unique_ptr<AccountCacheListener>(new AccountCacheListener(connStr));
+}
+
+// NEON_READ_REPLICA_URL sends the menu's pure reads to a read replica; see ReadRouter.
+// A replica that cannot be reached at startup is skipped with a warning.
+static std::unique_ptr<ReadRouter> readRouterFromEnv() {
+    const char* url = std::getenv("NEON_READ_REPLICA_URL");
+    if (!url || std::string(url).empty()) return nullptr;
+    int64_t maxLagMs = ReadRouter::kDefaultMaxLagMs;
+    const char* raw = std::getenv("NEON_READ_REPLICA_MAX_LAG_MS");
+    if (raw && std::string(raw).size() > 0) {
+        try {
+            maxLagMs = std::stoll(raw);
+        } catch (...) {
+            maxLagMs = -1;
+        }
+        if (maxLagMs < 0) {
+            std::cout << "Ignoring invalid NEON_READ_REPLICA_MAX_LAG_MS; using " << ReadRouter::kDefaultMaxLagMs << ".\n";
+            maxLagMs = ReadRouter::kDefaultMaxLagMs;
+        }
+    }
+    try {
+        // The session and each background worker read at most one thing at a time.
+        return std::unique_ptr<ReadRouter>(new ReadRouter(url, 1 + JobScheduler::kDefaultWorkers, maxLagMs));
+    } catch (const std::exception& ex) {
+        std::cout << "Read replica unavailable, reading from the primary: " << ex.what() << "\n";
+        return nullptr;
+    }
+}
+
+// BANK_METRICS_FILE turns on periodic metrics dumps (JSON for *.json, text otherwise).
+static std::unique_ptr<MetricsDumper> metricsDumperFromEnv() {
+    const char* path = std::getenv("BANK_METRICS_FILE");
+    if (!path || std::string(path).empty()) return nullptr;
+    long seconds = 60;
+    const char* raw = std::getenv("BANK_METRICS_INTERVAL");
+    if (raw && std::string(raw).size() > 0) {
+        try {
+            seconds = std::stol(raw);
+        } catch (...) {
+            seconds = 0;
+        }
+        if (seconds < 1) {
+            std::cout << "Ignoring invalid BANK_METRICS_INTERVAL; using 60.\n";
+            seconds = 60;
+        }
+    }
+    return std::unique_ptr<MetricsDumper>(new MetricsDumper(path, std::chrono::seconds(seconds)));
+}
+
+static bool parseCount(const std::string& s, size_t& out) {
+    try {
+        size_t idx = 0;
+        long v = std::stol(s, &idx);
+        if (idx != s.size() || v < 1) return false;
+        out = static_cast<size_t>(v);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool parseStatementBatchArgs(const std::vector<std::string>& command, StatementBatchOptions& options) {
+    if (command.size() < 2 || !parseYearMonth(command[1], options.year, options.month)) return false;
+    options.workers = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 2; i < command.size(); i += 2) {
+        if (i + 1 >= command.size()) return false;
+        if (command[i] == "--workers") {
+            if (!parseCount(command[i + 1], options.workers)) return false;
+        } else if (command[i] == "--batch") {
+            if (!parseCount(command[i + 1], options.batch_size)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseIngestArgs(const std::vector<std::string>& command, IngestOptions& options) {
+    if (command.size() < 2) return false;
+    options.path = command[1];
+    for (size_t i = 2; i < command.size(); i += 2) {
+        if (i + 1 >= command.size()) return false;
+        if (command[i] == "--batch") {
+            if (!parseCount(command[i + 1], options.batch_size)) return false;
+        } else if (command[i] == "--connections") {
+            if (!parseCount(command[i + 1], options.connections)) return false;
+        } else if (command[i] == "--errors") {
+            options.errors_path = command[i + 1];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseReconcileArgs(const std::vector<std::string>& command, ReconcileOptions& options) {
+    options.workers = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 1; i < command.size(); i += 2) {
+        if (i + 1 >= command.size()) return false;
+        size_t n = 0;
+        if (command[i] == "--workers") {
+            if (!parseCount(command[i + 1], options.workers)) return false;
+        } else if (command[i] == "--range") {
+            if (!parseCount(command[i + 1], n)) return false;
+            options.range_ids = static_cast<long long>(n);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseServeArgs(const std::vector<std::string>& command, ServerOptions& options) {
+    for (size_t i = 1; i < command.size(); i += 2) {
+        if (i + 1 >= command.size()) return false;
+        const std::string& value = command[i + 1];
+        size_t n = 0;
+        if (command[i] == "--host") {
+            options.host = value;
+        } else if (command[i] == "--port") {
+            if (!parseCount(value, n) || n > 65535) return false;
+            options.port = static_cast<int>(n);
+        } else if (command[i] == "--loops") {
+            if (!parseCount(value, options.event_loops)) return false;
+        } else if (command[i] == "--workers") {
+            if (!parseCount(value, options.db_workers)) return false;
+        } else if (command[i] == "--pipelined") {
+            if (!parseCount(value, options.pipelined_connections)) return false;
+        } else if (command[i] == "--idle-timeout") {
+            if (!parseCount(value, n)) return false;
+            options.idle_timeout_seconds = static_cast<int>(n);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "host", "host:port" or ":port".
+static bool parseServerAddress(const std::string& text, std::string& host, int& port) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) {
+        if (!text.empty()) host = text;
+        return true;
+    }
+    if (colon > 0) host = text.substr(0, colon);
+    size_t n = 0;
+    if (!parseCount(text.substr(colon + 1), n) || n > 65535) return false;
+    port = static_cast<int>(n);
+    return true;
+}
+
+static void printUsage() {
+    std::cout << "Usage: main.exe [--unprepared] [--timing] [command]\n";
+    std::cout << "Commands:\n";
+    std::cout << "  (none)                  interactive menu\n";
+    std::cout << "  migrate                 apply pending schema migrations and list them all\n";
+    std::cout << "  verify-totals [--fix]   check monthly_totals against the ledger\n";
+    std::cout << "  partitions [--ahead N]  create monthly ledger partitions N months ahead (default 3) and list them\n";
+    std::cout << "  archive-partitions YYYY-MM [--dir D]\n";
+    std::cout << "                          export every ledger partition before that month to D, then drop it\n";
+    std::cout << "  statements YYYY-MM [--workers N] [--batch N]\n";
+    std::cout << "                          generate that month's statement for every account\n";
+    std::cout << "  ingest FILE [--batch N] [--connections N] [--errors PATH]\n";
+    std::cout << "                          apply a CSV/NDJSON file of deposits, withdrawals and transfers (Linux)\n";
+    std::cout << "  reconcile [--workers N] [--range N]\n";
+    std::cout << "                          check every balance against its ledger rows in parallel\n";
+    std::cout << "  serve [--host H] [--port N] [--loops N] [--workers N] [--idle-timeout S] [--pipelined N]\n";
+    std::cout << "                          serve the menu operations over TCP (Linux)\n";
+    std::cout << "  connect [host][:port]   interactive menu against a running server\n";
+    std::cout << "  local PATH [--no-fsync] interactive menu on an embedded journaled ledger in PATH (POSIX)\n";
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> command;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (!command.empty()) {
+            command.push_back(arg);
+        } else if (arg == "--unprepared") {
+            setPreparedStatementsEnabled(false);
+        } else if (arg == "--timing") {
+            setShowOperationTiming(true);
+        } else if (arg.rfind("--", 0) != 0) {
+            command.push_back(arg);
+        } else {
+            std::cout << "Unknown option: " << arg << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+
+    ServerOptions serverOptions;
+    if (!command.empty() && command[0] == "connect") {
+        std::string host = serverOptions.host;
+        int port = serverOptions.port;
+        if (command.size() > 2 || (command.size() == 2 && !parseServerAddress(command[1], host, port))) {
+            printUsage();
+            return 1;
+        }
+        return runClient(host, port);
+    }
+
+    if (!command.empty() && command[0] == "local") {
+        LocalLedgerOptions options;
+        if (command.size() == 3 && command[2] == "--no-fsync") {
+            options.fsync = false;
+        } else if (command.size() != 2) {
+            printUsage();
+            return 1;
+        }
+        std::unique_ptr<MetricsDumper> metricsDumper = metricsDumperFromEnv();
+        try {
+            LocalLedger ledger(command[1], options);
+            localMenu(ledger);
+        } catch (const std::exception& ex) {
+            std::cout << "Ledger error: " << ex.what() << "\n";
+            return 1;
+        }
+        return 0;
+    }
 
-int main() {
     const char* connStr = std::getenv("NEON_DATABASE_URL");
     if (!connStr || std::string(connStr).empty()) {
         std::cout << "Missing NEON_DATABASE_URL environment variable.\n";
         return 1;
     }
 
+    size_t poolSize = std::max(poolSizeFromEnv(), 2 + JobScheduler::kDefaultWorkers);
+    StatementBatchOptions batchOptions;
+    IngestOptions ingestOptions;
+    ReconcileOptions reconcileOptions;
+    if (!command.empty() && command[0] == "ingest") {
+        if (!parseIngestArgs(command, ingestOptions)) {
+            printUsage();
+            return 1;
+        }
+    } else if (!command.empty() && command[0] == "statements") {
+        if (!parseStatementBatchArgs(command, batchOptions)) {
+            printUsage();
+            return 1;
+        }
+        poolSize = std::max(poolSize, batchOptions.workers);
+    } else if (!command.empty() && command[0] == "reconcile") {
+        if (!parseReconcileArgs(command, reconcileOptions)) {
+            printUsage();
+            return 1;
+        }
+        poolSize = std::max(poolSize, reconcileOptions.workers + 1);
+    } else if (!command.empty() && command[0] == "serve") {
+        if (!parseServeArgs(command, serverOptions)) {
+            printUsage();
+            return 1;
+        }
+        poolSize = std::max(poolSize, 1 + JobScheduler::kDefaultWorkers + serverOptions.db_workers);
+    }
+
+    std::unique_ptr<MetricsDumper> metricsDumper = metricsDumperFromEnv();
+    configureAccountCacheFromEnv();
+
     try {
-        Database db(connStr);
+        Database db(connStr, poolSize);
         db.ensureSchema();
-        mainMenu(db.getConnection());
+
+        std::unique_ptr<AccountCacheListener> cacheListener;
+        if (command.empty() || command[0] == "serve") cacheListener = accountCacheListenerFromEnv(connStr);
+
+        if (command.empty()) {
+            LoginLogWriter loginLog(db);
+            // Outlives the scheduler: queued jobs may still read through it.
+            std::unique_ptr<ReadRouter> replica = readRouterFromEnv();
+            JobScheduler jobs(db);
+            mainMenu(db, loginLog, jobs, replica.get());
+        } else if (command[0] == "migrate") {
+            // ensureSchema() above already applied anything pending.
+            Database::Lease conn = db.acquire();
+            for (const MigrationStatus& m : migrationStatus(*conn)) {
+                std::cout << m.version << "  " << m.name << "  " << m.checksum << "  "
+                          << (m.applied_at.empty() ? "pending" : m.applied_at) << "\n";
+            }
+        } else if (command[0] == "verify-totals") {
+            bool fix = command.size() > 1 && command[1] == "--fix";
+            Database::Lease conn = db.acquire();
+            return verifyMonthlyTotals(*conn, fix) == 0 || fix ? 0 : 2;
+        } else if (command[0] == "partitions") {
+            size_t ahead = kPartitionMonthsAhead;
+            bool valid = command.size() == 1 ||
+                (command.size() == 3 && command[1] == "--ahead" && parseCount(command[2], ahead));
+            if (!valid) {
+                printUsage();
+                return 1;
+            }
+            Database::Lease conn = db.acquire();
+            pqxx::work tx(*conn);
+            int created = ensureTransactionPartitions(tx, static_cast<int>(ahead));
+            tx.commit();
+            for (const PartitionInfo& p : listTransactionPartitions(*conn)) {
+                std::cout << p.name << "  ~" << p.rows << " rows, " << p.bytes / 1024 << " KiB\n";
+            }
+            std::cout << created << " partition(s) created.\n";
+        } else if (command[0] == "archive-partitions") {
+            int year = 0;
+            int month = 0;
+            std::string dir = ".";
+            if (command.size() == 4 && command[2] == "--dir") dir = command[3];
+            bool valid = (command.size() == 2 || (command.size() == 4 && command[2] == "--dir")) &&
+                parseYearMonth(command[1], year, month);
+            if (!valid) {
+                printUsage();
+                return 1;
+            }
+            Database::Lease conn = db.acquire();
+            size_t archived = archiveTransactionPartitions(*conn, year, month, dir);
+            std::cout << archived << " partition(s) archived.\n";
+        } else if (command[0] == "serve") {
+            LoginLogWriter loginLog(db);
+            JobScheduler jobs(db);
+            std::unique_ptr<AsyncExecutor> async;
+            if (serverOptions.pipelined_connections > 0) {
+                async.reset(new AsyncExecutor(connStr, serverOptions.pipelined_connections));
+            }
+            return runServer(db, loginLog, jobs, async.get(), serverOptions) ? 0 : 1;
+        } else if (command[0] == "ingest") {
+            IngestResult result = runIngest(db, connStr, ingestOptions);
+            return result.rejected + result.failed == 0 ? 0 : 2;
+        } else if (command[0] == "statements") {
+            StatementBatchResult result = runStatementBatch(db, batchOptions);
+            return result.failed == 0 ? 0 : 2;
+        } else if (command[0] == "reconcile") {
+            ReconcileResult result = runReconcile(db, reconcileOptions);
+            return result.mismatches == 0 ? 0 : 2;
+        } else {
+            std::cout << "Unknown command: " << command[0] << "\n";
+            printUsage();
+            return 1;
+        }
     } catch (const std::exception& ex) {
         std::cout << "Database error: " << ex.what() << "\n";
         return 1;
     }
 
     return 0;
-}
+}
\ No newline at end of file
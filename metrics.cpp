@@ -0,0 +1,266 @@
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int kMaxMetrics = 128;
+const int kSubBucketBits = 2;
+const int kSubBuckets = 1 << kSubBucketBits;
+const int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+int bucketFor(uint64_t ns) {
+    if (ns < static_cast<uint64_t>(kSubBuckets)) return static_cast<int>(ns);
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = static_cast<int>((ns >> (msb - kSubBucketBits)) & (kSubBuckets - 1));
+    return (msb - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// Largest value that lands in bucket b.
+uint64_t bucketUpperNs(int b) {
+    if (b < kSubBuckets) return static_cast<uint64_t>(b);
+    int msb = b / kSubBuckets + kSubBucketBits - 1;
+    uint64_t sub = static_cast<uint64_t>(b % kSubBuckets);
+    uint64_t lower = (static_cast<uint64_t>(kSubBuckets) + sub) << (msb - kSubBucketBits);
+    return lower + (1ull << (msb - kSubBucketBits)) - 1;
+}
+
+struct Cell {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> db_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+    std::atomic<uint64_t> buckets[kBuckets];
+
+    Cell() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+    }
+};
+
+// Only the owning thread writes, so load+store is enough; no read-modify-write.
+inline void bump(std::atomic<uint64_t>& a, uint64_t v) {
+    a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+struct Shard {
+    std::atomic<Cell*> cells[kMaxMetrics];
+
+    Shard() {
+        for (auto& c : cells) c.store(nullptr, std::memory_order_relaxed);
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+    // Shards outlive their threads so finished work still shows up in dumps.
+    std::vector<Shard*> shards;
+};
+
+Registry& registry() {
+    static Registry* r = new Registry();
+    return *r;
+}
+
+Shard& threadShard() {
+    thread_local Shard* shard = [] {
+        Shard* s = new Shard();
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.shards.push_back(s);
+        return s;
+    }();
+    return *shard;
+}
+
+thread_local uint64_t threadDbNs = 0;
+
+uint64_t elapsedNs(std::chrono::steady_clock::time_point start) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+struct Snapshot {
+    std::string name;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t db_ns = 0;
+    uint64_t max_ns = 0;
+    std::vector<uint64_t> buckets;
+
+    uint64_t percentileNs(double p) const {
+        uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            seen += buckets[b];
+            if (seen > rank) return std::min(bucketUpperNs(b), max_ns);
+        }
+        return max_ns;
+    }
+};
+
+std::vector<Snapshot> snapshot() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<Snapshot> out(r.names.size());
+    for (size_t id = 0; id < r.names.size(); ++id) {
+        Snapshot& s = out[id];
+        s.name = r.names[id];
+        s.buckets.assign(kBuckets, 0);
+        for (Shard* shard : r.shards) {
+            Cell* c = shard->cells[id].load(std::memory_order_acquire);
+            if (!c) continue;
+            s.count += c->count.load(std::memory_order_relaxed);
+            s.total_ns += c->total_ns.load(std::memory_order_relaxed);
+            s.db_ns += c->db_ns.load(std::memory_order_relaxed);
+            s.max_ns = std::max(s.max_ns, c->max_ns.load(std::memory_order_relaxed));
+            for (int b = 0; b < kBuckets; ++b) s.buckets[b] += c->buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+    out.erase(std::remove_if(out.begin(), out.end(), [](const Snapshot& s) { return s.count == 0; }), out.end());
+    return out;
+}
+
+double us(uint64_t ns) {
+    return static_cast<double>(ns) / 1000.0;
+}
+
+} // namespace
+
+int metricId(const char* name) {
+    thread_local std::unordered_map<const char*, int> cache;
+    auto cached = cache.find(name);
+    if (cached != cache.end()) return cached->second;
+
+    Registry& r = registry();
+    int id = -1;
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto it = r.ids.find(name);
+        if (it != r.ids.end()) {
+            id = it->second;
+        } else if (r.names.size() < static_cast<size_t>(kMaxMetrics)) {
+            id = static_cast<int>(r.names.size());
+            r.names.push_back(name);
+            r.ids.emplace(name, id);
+        }
+    }
+    cache.emplace(name, id);
+    return id;
+}
+
+void recordMetric(int id, uint64_t total_ns, uint64_t db_ns) {
+    if (id < 0) return;
+    Shard& shard = threadShard();
+    Cell* c = shard.cells[id].load(std::memory_order_relaxed);
+    if (!c) {
+        c = new Cell();
+        shard.cells[id].store(c, std::memory_order_release);
+    }
+    bump(c->count, 1);
+    bump(c->total_ns, total_ns);
+    bump(c->db_ns, db_ns);
+    if (total_ns > c->max_ns.load(std::memory_order_relaxed)) c->max_ns.store(total_ns, std::memory_order_relaxed);
+    bump(c->buckets[bucketFor(total_ns)], 1);
+}
+
+std::string metricsText() {
+    std::ostringstream out;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-28s %9s %10s %10s %10s %10s %10s %10s\n",
+                  "operation", "count", "p50 us", "p90 us", "p99 us", "max us", "db us", "client us");
+    out << line;
+    for (const Snapshot& s : snapshot()) {
+        double avgDb = us(s.db_ns) / static_cast<double>(s.count);
+        double avgClient = us(s.total_ns - std::min(s.db_ns, s.total_ns)) / static_cast<double>(s.count);
+        std::snprintf(line, sizeof(line), "%-28s %9llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                      s.name.c_str(), static_cast<unsigned long long>(s.count),
+                      us(s.percentileNs(0.50)), us(s.percentileNs(0.90)), us(s.percentileNs(0.99)), us(s.max_ns),
+                      avgDb, avgClient);
+        out << line;
+    }
+    return out.str();
+}
+
+std::string metricsJson() {
+    std::ostringstream out;
+    out << "{\"unix_time\":" << std::chrono::duration_cast<std::chrono::seconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count()
+        << ",\"operations\":[";
+    bool first = true;
+    for (const Snapshot& s : snapshot()) {
+        if (!first) out << ",";
+        first = false;
+        out << "{\"name\":\"" << s.name << "\""
+            << ",\"count\":" << s.count
+            << ",\"total_ns\":" << s.total_ns
+            << ",\"db_ns\":" << s.db_ns
+            << ",\"p50_ns\":" << s.percentileNs(0.50)
+            << ",\"p90_ns\":" << s.percentileNs(0.90)
+            << ",\"p99_ns\":" << s.percentileNs(0.99)
+            << ",\"p999_ns\":" << s.percentileNs(0.999)
+            << ",\"max_ns\":" << s.max_ns << "}";
+    }
+    out << "]}\n";
+    return out.str();
+}
+
+DbTimer::DbTimer(const char* name) : id_(metricId(name)), start_(std::chrono::steady_clock::now()) {}
+
+DbTimer::~DbTimer() {
+    uint64_t ns = elapsedNs(start_);
+    threadDbNs += ns;
+    recordMetric(id_, ns, ns);
+}
+
+ActionTimer::ActionTimer(const char* name)
+    : id_(metricId(name)), start_(std::chrono::steady_clock::now()), dbStart_(threadDbNs) {}
+
+ActionTimer::~ActionTimer() {
+    recordMetric(id_, elapsedNs(start_), threadDbNs - dbStart_);
+}
+
+MetricsDumper::MetricsDumper(const std::string& path, std::chrono::seconds interval)
+    : path_(path), interval_(interval) {
+    worker_ = std::thread(&MetricsDumper::run, this);
+}
+
+MetricsDumper::~MetricsDumper() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    worker_.join();
+    dump();
+}
+
+void MetricsDumper::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wake_.wait_for(lock, interval_, [this] { return stopping_; })) {
+        dump();
+    }
+}
+
+// Written to a temp file and renamed over the old dump, so readers always see
+// a complete file. rename replaces the target atomically on POSIX; Windows
+// refuses an existing target, so only there is the old dump removed first.
+void MetricsDumper::dump() const {
+    bool json = path_.size() >= 5 && path_.compare(path_.size() - 5, 5, ".json") == 0;
+    std::string tmp = path_ + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << (json ? metricsJson() : metricsText());
+    }
+#if defined(_WIN32)
+    if (std::rename(tmp.c_str(), path_.c_str()) == 0) return;
+    std::remove(path_.c_str());
+#endif
+    std::rename(tmp.c_str(), path_.c_str());
+}
@@ -0,0 +1,76 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Low-overhead latency metrics, cheap enough to leave on in production.
+// Every thread records into its own shard with relaxed single-writer stores
+// (no locks, no contended cache lines); readers merge all shards on demand.
+// Latencies go into log-linear buckets: 4 per power of two, so about 19% precision.
+
+// Registers name on first use; ids are cached per thread, so hot call sites
+// only pay for a pointer lookup.
+int metricId(const char* name);
+void recordMetric(int id, uint64_t total_ns, uint64_t db_ns);
+
+std::string metricsText();
+std::string metricsJson();
+
+// Times one database round-trip. Recorded under its own name and charged to
+// whatever ActionTimer is running on this thread.
+class DbTimer {
+public:
+    explicit DbTimer(const char* name);
+    ~DbTimer();
+
+    DbTimer(const DbTimer&) = delete;
+    DbTimer& operator=(const DbTimer&) = delete;
+
+private:
+    int id_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Times a menu action or API call and splits it into database and client time.
+class ActionTimer {
+public:
+    explicit ActionTimer(const char* name);
+    ~ActionTimer();
+
+    ActionTimer(const ActionTimer&) = delete;
+    ActionTimer& operator=(const ActionTimer&) = delete;
+
+private:
+    int id_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t dbStart_;
+};
+
+// Rewrites path every interval with the current metrics: JSON when the path
+// ends in .json, text otherwise. Writes a final snapshot when destroyed.
+class MetricsDumper {
+public:
+    MetricsDumper(const std::string& path, std::chrono::seconds interval);
+    ~MetricsDumper();
+
+    MetricsDumper(const MetricsDumper&) = delete;
+    MetricsDumper& operator=(const MetricsDumper&) = delete;
+
+private:
+    void run();
+    void dump() const;
+
+    std::string path_;
+    std::chrono::seconds interval_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::thread worker_;
+};
+
+#endif // METRICS_H
@@ -8,9 +8,12 @@ if (-not $DatabaseUrl) {
     exit 1
 }
 
-if (-not (Get-Command psql -ErrorAction SilentlyContinue)) {
-    Write-Host "psql is not available in PATH. Install PostgreSQL client tools."
+if (-not (Test-Path .\main.exe)) {
+    Write-Host "main.exe not found. Build it first (see README.md)."
     exit 1
 }
 
-psql "$DatabaseUrl" -f migrations.sql
+# The migrations are compiled into main.exe; this applies the pending ones and lists them.
+$env:NEON_DATABASE_URL = $DatabaseUrl
+.\main.exe migrate
+exit $LASTEXITCODE
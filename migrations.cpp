@@ -0,0 +1,574 @@
+#include "migrations.h"
+#include "account.h"
+#include "partitions.h"
+#include "transaction.h"
+#include <map>
+#include <stdexcept>
+
+namespace {
+
+// pg_advisory_xact_lock key shared by every instance ("bankmigr").
+const long long kMigrationLockKey = 0x62616e6b6d696772ll;
+
+// Every migration is safe to run against a database that was set up by the
+// old run-all-DDL-at-startup code, so the first versioned start adopts it.
+const std::vector<Migration> kMigrations = {
+    {1, "base_tables", R"SQL(
+CREATE TABLE IF NOT EXISTS accounts (
+    id SERIAL PRIMARY KEY,
+    username TEXT UNIQUE NOT NULL,
+    pin_hash TEXT NOT NULL,
+    salt TEXT NOT NULL,
+    balance NUMERIC(12,2) NOT NULL DEFAULT 0,
+    failed_attempts INT NOT NULL DEFAULT 0,
+    locked_until BIGINT NOT NULL DEFAULT 0,
+    created_at TIMESTAMPTZ NOT NULL DEFAULT NOW()
+);
+
+CREATE TABLE IF NOT EXISTS transactions (
+    id BIGSERIAL PRIMARY KEY,
+    account_id INT NOT NULL REFERENCES accounts(id),
+    type TEXT NOT NULL,
+    amount NUMERIC(12,2) NOT NULL,
+    counterparty TEXT,
+    note TEXT,
+    created_at TIMESTAMPTZ NOT NULL DEFAULT NOW()
+);
+
+CREATE INDEX IF NOT EXISTS transactions_account_id_idx
+ON transactions(account_id, id);
+
+CREATE TABLE IF NOT EXISTS statements (
+    id BIGSERIAL PRIMARY KEY,
+    account_id INT NOT NULL REFERENCES accounts(id),
+    statement_month DATE NOT NULL,
+    generated_at TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    total_in NUMERIC(12,2) NOT NULL,
+    total_out NUMERIC(12,2) NOT NULL,
+    ending_balance NUMERIC(12,2) NOT NULL,
+    items_json TEXT NOT NULL
+);
+
+CREATE UNIQUE INDEX IF NOT EXISTS statements_unique
+ON statements(account_id, statement_month);
+
+CREATE TABLE IF NOT EXISTS login_logs (
+    id BIGSERIAL PRIMARY KEY,
+    account_id INT NOT NULL REFERENCES accounts(id),
+    login_time TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    success BOOLEAN NOT NULL,
+    ip_address TEXT,
+    user_agent TEXT
+);
+)SQL"},
+
+    {2, "monthly_totals", R"SQL(
+CREATE TABLE IF NOT EXISTS monthly_totals (
+    account_id INT NOT NULL REFERENCES accounts(id),
+    month DATE NOT NULL,
+    total_in NUMERIC(12,2) NOT NULL DEFAULT 0,
+    total_out NUMERIC(12,2) NOT NULL DEFAULT 0,
+    txn_count INT NOT NULL DEFAULT 0,
+    PRIMARY KEY (account_id, month)
+);
+
+-- 1 = money in, -1 = money out, 0 = neither (e.g. FakeTransfer).
+CREATE OR REPLACE FUNCTION transaction_direction(t TEXT) RETURNS SMALLINT
+LANGUAGE sql IMMUTABLE AS $$
+    SELECT CASE
+        WHEN t IN ('Deposit', 'InitialDeposit', 'TransferIn') THEN 1
+        WHEN t IN ('Withdraw', 'TransferOut') THEN -1
+        ELSE 0
+    END::smallint
+$$;
+
+-- Keeps monthly_totals in step with every ledger insert, in the inserting transaction.
+CREATE OR REPLACE FUNCTION apply_monthly_totals() RETURNS trigger
+LANGUAGE plpgsql AS $$
+DECLARE
+    dir SMALLINT := transaction_direction(NEW.type);
+BEGIN
+    INSERT INTO monthly_totals AS m (account_id, month, total_in, total_out, txn_count)
+    VALUES (NEW.account_id, date_trunc('month', NEW.created_at)::date,
+            CASE WHEN dir = 1 THEN NEW.amount ELSE 0 END,
+            CASE WHEN dir = -1 THEN NEW.amount ELSE 0 END,
+            1)
+    ON CONFLICT (account_id, month) DO UPDATE SET
+        total_in = m.total_in + EXCLUDED.total_in,
+        total_out = m.total_out + EXCLUDED.total_out,
+        txn_count = m.txn_count + 1;
+    RETURN NULL;
+END
+$$;
+
+DO $$
+BEGIN
+    IF NOT EXISTS (SELECT 1 FROM pg_trigger WHERE tgname = 'transactions_monthly_totals') THEN
+        CREATE TRIGGER transactions_monthly_totals
+        AFTER INSERT ON transactions
+        FOR EACH ROW EXECUTE FUNCTION apply_monthly_totals();
+
+        -- First install: seed the rollups from the existing ledger.
+        INSERT INTO monthly_totals (account_id, month, total_in, total_out, txn_count)
+        SELECT account_id, date_trunc('month', created_at)::date,
+               COALESCE(SUM(amount) FILTER (WHERE transaction_direction(type) = 1), 0),
+               COALESCE(SUM(amount) FILTER (WHERE transaction_direction(type) = -1), 0),
+               COUNT(*)
+        FROM transactions
+        GROUP BY 1, 2
+        ON CONFLICT (account_id, month) DO NOTHING;
+    END IF;
+END
+$$;
+)SQL"},
+
+    // Monthly range partitions on created_at: a statement month reads one
+    // partition, and old months are detached instead of deleted row by row.
+    // The plain table is moved aside and its rows copied in; the rollup
+    // trigger is only re-created afterwards, so they are not counted twice.
+    {3, "partition_transactions_by_month", R"SQL(
+DO $$
+BEGIN
+    IF (SELECT relkind FROM pg_class WHERE oid = to_regclass('transactions')) = 'r' THEN
+        ALTER TABLE transactions RENAME TO transactions_unpartitioned;
+        ALTER TABLE transactions_unpartitioned RENAME CONSTRAINT transactions_pkey TO transactions_unpartitioned_pkey;
+        ALTER INDEX IF EXISTS transactions_account_id_idx RENAME TO transactions_unpartitioned_account_id_idx;
+        DROP TRIGGER IF EXISTS transactions_monthly_totals ON transactions_unpartitioned;
+        ALTER SEQUENCE transactions_id_seq OWNED BY NONE;
+    END IF;
+END
+$$;
+
+CREATE SEQUENCE IF NOT EXISTS transactions_id_seq;
+
+-- The primary key has to include the partition key.
+CREATE TABLE IF NOT EXISTS transactions (
+    id BIGINT NOT NULL DEFAULT nextval('transactions_id_seq'),
+    account_id INT NOT NULL REFERENCES accounts(id),
+    type TEXT NOT NULL,
+    amount NUMERIC(12,2) NOT NULL,
+    counterparty TEXT,
+    note TEXT,
+    created_at TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    PRIMARY KEY (id, created_at)
+) PARTITION BY RANGE (created_at);
+
+ALTER SEQUENCE transactions_id_seq OWNED BY transactions.id;
+
+CREATE TABLE IF NOT EXISTS transactions_default PARTITION OF transactions DEFAULT;
+
+CREATE INDEX IF NOT EXISTS transactions_account_id_idx
+ON transactions(account_id, id);
+
+CREATE INDEX IF NOT EXISTS transactions_account_created_idx
+ON transactions(account_id, created_at, id);
+
+-- Creates transactions_YYYY_MM for every month from first_month to
+-- last_month that has none, moving any rows the default partition
+-- already holds for that month. Returns the number created.
+CREATE OR REPLACE FUNCTION ensure_transaction_partitions(first_month DATE, last_month DATE) RETURNS INT
+LANGUAGE plpgsql AS $$
+DECLARE
+    m DATE := date_trunc('month', first_month)::date;
+    part TEXT;
+    created INT := 0;
+BEGIN
+    WHILE m <= last_month LOOP
+        part := 'transactions_' || to_char(m, 'YYYY_MM');
+        IF to_regclass(part) IS NULL THEN
+            EXECUTE format('CREATE TABLE %I (LIKE transactions INCLUDING DEFAULTS)', part);
+            EXECUTE format('WITH moved AS (DELETE FROM transactions_default '
+                           'WHERE created_at >= %L AND created_at < %L RETURNING *) '
+                           'INSERT INTO %I SELECT * FROM moved',
+                           m, (m + interval '1 month')::date, part);
+            EXECUTE format('ALTER TABLE transactions ATTACH PARTITION %I FOR VALUES FROM (%L) TO (%L)',
+                           part, m, (m + interval '1 month')::date);
+            created := created + 1;
+        END IF;
+        m := (m + interval '1 month')::date;
+    END LOOP;
+    RETURN created;
+END
+$$;
+
+DO $$
+BEGIN
+    IF to_regclass('transactions_unpartitioned') IS NOT NULL THEN
+        PERFORM ensure_transaction_partitions(
+            COALESCE((SELECT min(created_at) FROM transactions_unpartitioned)::date, CURRENT_DATE),
+            CURRENT_DATE);
+        INSERT INTO transactions (id, account_id, type, amount, counterparty, note, created_at)
+        SELECT id, account_id, type, amount, counterparty, note, created_at
+        FROM transactions_unpartitioned;
+        DROP TABLE transactions_unpartitioned;
+    END IF;
+
+    IF NOT EXISTS (SELECT 1 FROM pg_trigger
+                   WHERE tgname = 'transactions_monthly_totals' AND tgrelid = 'transactions'::regclass) THEN
+        CREATE TRIGGER transactions_monthly_totals
+        AFTER INSERT ON transactions
+        FOR EACH ROW EXECUTE FUNCTION apply_monthly_totals();
+    END IF;
+END
+$$;
+
+CREATE TABLE IF NOT EXISTS archived_partitions (
+    month DATE PRIMARY KEY,
+    row_count BIGINT NOT NULL,
+    archive_file TEXT NOT NULL,
+    archived_at TIMESTAMPTZ NOT NULL DEFAULT NOW()
+);
+)SQL"},
+    // Invalidations for other instances' account caches (see AccountCacheListener).
+    // Off unless bank.account_notify is 'on': NOTIFY serialises committing
+    // transactions, so single-instance deployments should not pay for it.
+    {4, "account_change_notify", R"SQL(
+CREATE OR REPLACE FUNCTION notify_account_change() RETURNS trigger AS $$
+BEGIN
+    PERFORM pg_notify('account_changes', OLD.id::text);
+    RETURN NULL;
+END;
+$$ LANGUAGE plpgsql;
+
+DROP TRIGGER IF EXISTS accounts_notify_change ON accounts;
+CREATE TRIGGER accounts_notify_change
+AFTER UPDATE ON accounts
+FOR EACH ROW
+WHEN (current_setting('bank.account_notify', true) IS NOT DISTINCT FROM 'on')
+EXECUTE FUNCTION notify_account_change();
+)SQL"},
+    // One row per committed ingestion batch: the file's lines [first_line,
+    // first_line + line_count) are done (see ingest.h).
+    {5, "ingest_batches", R"SQL(
+CREATE TABLE IF NOT EXISTS ingest_batches (
+    file_hash TEXT NOT NULL,
+    first_line BIGINT NOT NULL,
+    line_count INT NOT NULL,
+    committed_at TIMESTAMPTZ NOT NULL DEFAULT NOW(),
+    PRIMARY KEY (file_hash, first_line)
+);
+)SQL"},
+    // transactions.type TEXT becomes kind SMALLINT, interned in
+    // transaction_kinds; the ids are TransactionKind in transaction.h. The
+    // conversion rewrites every partition under an exclusive lock. There is
+    // no foreign key: every ledger insert would share-lock its kind's row.
+    {6, "transaction_kinds", R"SQL(
+CREATE TABLE IF NOT EXISTS transaction_kinds (
+    id SMALLINT PRIMARY KEY,
+    name TEXT NOT NULL UNIQUE,
+    direction SMALLINT NOT NULL,    -- 1 = money in, -1 = money out, 0 = neither
+    simulated BOOLEAN NOT NULL      -- recorded without moving money
+);
+
+INSERT INTO transaction_kinds (id, name, direction, simulated) VALUES
+    (1, 'Deposit', 1, false),
+    (2, 'Withdraw', -1, false),
+    (3, 'TransferIn', 1, false),
+    (4, 'TransferOut', -1, false),
+    (5, 'FakeTransfer', 0, true),
+    (6, 'InitialDeposit', 1, false)
+ON CONFLICT (id) DO NOTHING;
+
+DO $$
+DECLARE
+    unknown TEXT;
+BEGIN
+    IF EXISTS (SELECT 1 FROM information_schema.columns
+               WHERE table_schema = current_schema() AND table_name = 'transactions' AND column_name = 'type') THEN
+        SELECT string_agg(DISTINCT type, ', ') INTO unknown
+        FROM transactions WHERE type NOT IN (SELECT name FROM transaction_kinds);
+        IF unknown IS NOT NULL THEN
+            RAISE EXCEPTION 'transactions.type values without a transaction kind: %', unknown;
+        END IF;
+
+        ALTER TABLE transactions ALTER COLUMN type TYPE SMALLINT USING (CASE type
+            WHEN 'Deposit' THEN 1
+            WHEN 'Withdraw' THEN 2
+            WHEN 'TransferIn' THEN 3
+            WHEN 'TransferOut' THEN 4
+            WHEN 'FakeTransfer' THEN 5
+            WHEN 'InitialDeposit' THEN 6
+        END);
+        ALTER TABLE transactions RENAME COLUMN type TO kind;
+    END IF;
+END
+$$;
+
+-- The direction column of transaction_kinds as an inlinable expression, so
+-- FILTER clauses and the rollup trigger compare integers.
+CREATE OR REPLACE FUNCTION transaction_direction(k SMALLINT) RETURNS SMALLINT
+LANGUAGE sql IMMUTABLE AS $$
+    SELECT CASE
+        WHEN k IN (1, 3, 6) THEN 1
+        WHEN k IN (2, 4) THEN -1
+        ELSE 0
+    END::smallint
+$$;
+
+CREATE OR REPLACE FUNCTION apply_monthly_totals() RETURNS trigger
+LANGUAGE plpgsql AS $$
+DECLARE
+    dir SMALLINT := transaction_direction(NEW.kind);
+BEGIN
+    INSERT INTO monthly_totals AS m (account_id, month, total_in, total_out, txn_count)
+    VALUES (NEW.account_id, date_trunc('month', NEW.created_at)::date,
+            CASE WHEN dir = 1 THEN NEW.amount ELSE 0 END,
+            CASE WHEN dir = -1 THEN NEW.amount ELSE 0 END,
+            1)
+    ON CONFLICT (account_id, month) DO UPDATE SET
+        total_in = m.total_in + EXCLUDED.total_in,
+        total_out = m.total_out + EXCLUDED.total_out,
+        txn_count = m.txn_count + 1;
+    RETURN NULL;
+END
+$$;
+
+DROP FUNCTION IF EXISTS transaction_direction(TEXT);
+)SQL"},
+    // Partition bounds were DATE values cast with the session TimeZone, so
+    // sessions in different zones created shifted or overlapping months. A
+    // month is now always the UTC month. Existing partitions whose bounds are
+    // off are detached and their rows re-routed; those rows are already in
+    // monthly_totals, so the rollup trigger is off while they move.
+    {7, "utc_partition_bounds", R"SQL(
+CREATE OR REPLACE FUNCTION ensure_transaction_partitions(first_month DATE, last_month DATE) RETURNS INT
+LANGUAGE plpgsql AS $$
+DECLARE
+    m DATE := date_trunc('month', first_month)::date;
+    part TEXT;
+    lo TIMESTAMPTZ;
+    hi TIMESTAMPTZ;
+    created INT := 0;
+BEGIN
+    WHILE m <= last_month LOOP
+        part := 'transactions_' || to_char(m, 'YYYY_MM');
+        IF to_regclass(part) IS NULL THEN
+            lo := m::timestamp AT TIME ZONE 'UTC';
+            hi := (m + interval '1 month')::timestamp AT TIME ZONE 'UTC';
+            EXECUTE format('CREATE TABLE %I (LIKE transactions INCLUDING DEFAULTS)', part);
+            EXECUTE format('WITH moved AS (DELETE FROM transactions_default '
+                           'WHERE created_at >= %L AND created_at < %L RETURNING *) '
+                           'INSERT INTO %I SELECT * FROM moved',
+                           lo, hi, part);
+            EXECUTE format('ALTER TABLE transactions ATTACH PARTITION %I FOR VALUES FROM (%L) TO (%L)',
+                           part, lo, hi);
+            created := created + 1;
+        END IF;
+        m := (m + interval '1 month')::date;
+    END LOOP;
+    RETURN created;
+END
+$$;
+
+DO $$
+DECLARE
+    p RECORD;
+    shifted TEXT[] := '{}';
+    t TEXT;
+    first_month DATE;
+    last_month DATE;
+BEGIN
+    FOR p IN
+        SELECT c.relname AS name, to_date(substr(c.relname, 14), 'YYYY_MM') AS month,
+               substring(pg_get_expr(c.relpartbound, c.oid) FROM $re$FROM \('([^']+)'\)$re$)::timestamptz AS lo,
+               substring(pg_get_expr(c.relpartbound, c.oid) FROM $re$TO \('([^']+)'\)$re$)::timestamptz AS hi
+        FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid
+        WHERE i.inhparent = 'transactions'::regclass AND c.relname ~ '^transactions_[0-9]{4}_[0-9]{2}$'
+    LOOP
+        IF p.lo <> p.month::timestamp AT TIME ZONE 'UTC'
+           OR p.hi <> (p.month + interval '1 month')::timestamp AT TIME ZONE 'UTC' THEN
+            EXECUTE format('ALTER TABLE transactions DETACH PARTITION %I', p.name);
+            EXECUTE format('ALTER TABLE %I RENAME TO %I', p.name, p.name || '_shifted');
+            shifted := shifted || (p.name || '_shifted');
+            first_month := LEAST(first_month, p.month);
+            last_month := GREATEST(last_month, p.month);
+        END IF;
+    END LOOP;
+
+    IF first_month IS NOT NULL THEN
+        PERFORM ensure_transaction_partitions(first_month, last_month);
+        ALTER TABLE transactions DISABLE TRIGGER transactions_monthly_totals;
+        FOREACH t IN ARRAY shifted LOOP
+            EXECUTE format('INSERT INTO transactions SELECT * FROM %I', t);
+            EXECUTE format('DROP TABLE %I', t);
+        END LOOP;
+        ALTER TABLE transactions ENABLE TRIGGER transactions_monthly_totals;
+    END IF;
+END
+$$;
+)SQL"},
+    // The rollup month was date_trunc() of a timestamptz, which is the month
+    // in the session TimeZone: it could disagree with the UTC partition
+    // month and with verify-totals run from another zone. Months still in the
+    // ledger are re-bucketed from it once; archived months keep their rows.
+    {8, "utc_monthly_totals", R"SQL(
+CREATE OR REPLACE FUNCTION apply_monthly_totals() RETURNS trigger
+LANGUAGE plpgsql AS $$
+DECLARE
+    dir SMALLINT := transaction_direction(NEW.kind);
+BEGIN
+    INSERT INTO monthly_totals AS m (account_id, month, total_in, total_out, txn_count)
+    VALUES (NEW.account_id, date_trunc('month', NEW.created_at AT TIME ZONE 'UTC')::date,
+            CASE WHEN dir = 1 THEN NEW.amount ELSE 0 END,
+            CASE WHEN dir = -1 THEN NEW.amount ELSE 0 END,
+            1)
+    ON CONFLICT (account_id, month) DO UPDATE SET
+        total_in = m.total_in + EXCLUDED.total_in,
+        total_out = m.total_out + EXCLUDED.total_out,
+        txn_count = m.txn_count + 1;
+    RETURN NULL;
+END
+$$;
+
+LOCK TABLE transactions IN SHARE MODE;
+DELETE FROM monthly_totals WHERE month NOT IN (SELECT month FROM archived_partitions);
+INSERT INTO monthly_totals AS m (account_id, month, total_in, total_out, txn_count)
+SELECT account_id, date_trunc('month', created_at AT TIME ZONE 'UTC')::date,
+       COALESCE(SUM(amount) FILTER (WHERE transaction_direction(kind) = 1), 0),
+       COALESCE(SUM(amount) FILTER (WHERE transaction_direction(kind) = -1), 0),
+       COUNT(*)
+FROM transactions
+GROUP BY 1, 2
+ON CONFLICT (account_id, month) DO UPDATE SET
+    total_in = m.total_in + EXCLUDED.total_in,
+    total_out = m.total_out + EXCLUDED.total_out,
+    txn_count = m.txn_count + EXCLUDED.txn_count;
+)SQL"},
+};
+
+std::map<int, std::string> appliedChecksums(pqxx::transaction_base& tx) {
+    std::map<int, std::string> applied;
+    for (const auto& row : tx.exec("SELECT version, checksum FROM schema_migrations")) {
+        applied[row["version"].as<int>()] = row["checksum"].c_str();
+    }
+    return applied;
+}
+
+// True when every embedded migration is recorded; throws on a checksum mismatch.
+bool upToDate(const std::map<int, std::string>& applied) {
+    bool current = true;
+    for (const Migration& m : kMigrations) {
+        auto it = applied.find(m.version);
+        if (it == applied.end()) {
+            current = false;
+        } else if (it->second != migrationChecksum(m)) {
+            throw std::runtime_error("Migration " + std::to_string(m.version) + " (" + m.name +
+                                     ") differs from the one applied to this database");
+        }
+    }
+    return current;
+}
+
+// transaction_kinds and transaction_direction() as "id:name:direction:simulated:fn"
+// per kind. Both restate the traits table in transaction.h, so every start
+// compares them with it.
+const char* kKindsSignatureSql =
+    "(SELECT string_agg(id || ':' || name || ':' || direction || ':' || simulated || ':' || "
+    "transaction_direction(id), ',' ORDER BY id) FROM transaction_kinds)";
+
+std::string expectedKindsSignature() {
+    std::string out;
+    for (long code = 1; code <= static_cast<long>(TransactionKind::InitialDeposit); ++code) {
+        TransactionKind kind = static_cast<TransactionKind>(code);
+        std::string direction = std::to_string(transactionDirection(kind));
+        if (!out.empty()) out += ',';
+        out += std::to_string(code) + ':' + transactionKindName(kind) + ':' + direction + ':' +
+               (transactionKindTraits(kind).simulated ? "true" : "false") + ':' + direction;
+    }
+    return out;
+}
+
+void checkKindsSignature(const std::string& actual) {
+    std::string expected = expectedKindsSignature();
+    if (actual != expected) {
+        throw std::runtime_error("transaction_kinds / transaction_direction() do not match TransactionKind: database has " +
+                                 actual + ", this build expects " + expected);
+    }
+}
+
+} // namespace
+
+const std::vector<Migration>& migrations() {
+    return kMigrations;
+}
+
+std::string migrationChecksum(const Migration& m) {
+    return toHex(fnv1a64(m.sql));
+}
+
+size_t migrateSchema(pqxx::connection& conn) {
+    // Fast path: one read, no locks beyond the catalog lookups.
+    {
+        pqxx::nontransaction tx(conn);
+        try {
+            pqxx::result res = tx.exec(
+                "SELECT version, checksum, "
+                "to_regclass('transactions_' || to_char((now() AT TIME ZONE 'UTC') + interval '1 month', 'YYYY_MM')) IS NOT NULL "
+                "AS partitions_ready, " + std::string(kKindsSignatureSql) + " AS kinds "
+                "FROM schema_migrations");
+            std::map<int, std::string> applied;
+            bool partitionsReady = false;
+            std::string kinds;
+            for (const auto& row : res) {
+                applied[row["version"].as<int>()] = row["checksum"].c_str();
+                partitionsReady = row["partitions_ready"].as<bool>();
+                kinds = row["kinds"].c_str();
+            }
+            if (upToDate(applied) && partitionsReady) {
+                checkKindsSignature(kinds);
+                return 0;
+            }
+        } catch (const pqxx::undefined_table&) {
+            // First start against this database, or one from before transaction_kinds.
+        }
+    }
+
+    pqxx::work tx(conn);
+    tx.exec_params("SELECT pg_advisory_xact_lock($1)", kMigrationLockKey);
+    tx.exec(
+        "CREATE TABLE IF NOT EXISTS schema_migrations ("
+        "  version INT PRIMARY KEY,"
+        "  name TEXT NOT NULL,"
+        "  checksum TEXT NOT NULL,"
+        "  applied_at TIMESTAMPTZ NOT NULL DEFAULT NOW()"
+        ")");
+
+    // Re-read under the lock: another instance may have finished meanwhile.
+    std::map<int, std::string> applied = appliedChecksums(tx);
+    size_t count = 0;
+    if (!upToDate(applied)) {
+        for (const Migration& m : kMigrations) {
+            if (applied.count(m.version)) continue;
+            tx.exec(m.sql);
+            tx.exec_params("INSERT INTO schema_migrations (version, name, checksum) VALUES ($1, $2, $3)",
+                           m.version, m.name, migrationChecksum(m));
+            ++count;
+        }
+    }
+    checkKindsSignature(tx.exec(std::string("SELECT ") + kKindsSignatureSql)[0][0].c_str());
+    ensureTransactionPartitions(tx);
+    tx.commit();
+    return count;
+}
+
+std::vector<MigrationStatus> migrationStatus(pqxx::connection& conn) {
+    std::map<int, std::string> appliedAt;
+    {
+        pqxx::read_transaction tx(conn);
+        for (const auto& row : tx.exec("SELECT version, applied_at::text AS applied_at FROM schema_migrations")) {
+            appliedAt[row["version"].as<int>()] = row["applied_at"].c_str();
+        }
+    }
+
+    std::vector<MigrationStatus> out;
+    for (const Migration& m : kMigrations) {
+        MigrationStatus s;
+        s.version = m.version;
+        s.name = m.name;
+        s.checksum = migrationChecksum(m);
+        auto it = appliedAt.find(m.version);
+        if (it != appliedAt.end()) s.applied_at = it->second;
+        out.push_back(std::move(s));
+    }
+    return out;
+}
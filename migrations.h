@@ -0,0 +1,37 @@
+#ifndef MIGRATIONS_H
+#define MIGRATIONS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <pqxx/pqxx>
+
+// Schema changes are numbered migrations compiled into the binary and
+// recorded in schema_migrations with a checksum of their SQL. Append new
+// migrations to the list in migrations.cpp; never edit one that has shipped.
+struct Migration {
+    int version;
+    const char* name;
+    const char* sql;
+};
+
+struct MigrationStatus {
+    int version = 0;
+    std::string name;
+    std::string checksum;
+    std::string applied_at;    // empty while pending
+};
+
+const std::vector<Migration>& migrations();
+// fnv1a64 of the SQL text, as 16 hex digits.
+std::string migrationChecksum(const Migration& m);
+
+// One lookup when the schema is current. Otherwise takes an advisory lock,
+// applies the missing migrations in order in one transaction (so concurrent
+// starters wait for the first and then find nothing to do) and creates the
+// upcoming ledger partitions. Throws if an applied migration's checksum no
+// longer matches the binary. Returns the number of migrations applied.
+size_t migrateSchema(pqxx::connection& conn);
+std::vector<MigrationStatus> migrationStatus(pqxx::connection& conn);
+
+#endif // MIGRATIONS_H
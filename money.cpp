@@ -0,0 +1,92 @@
+#include "money.h"
+#include <stdexcept>
+
+namespace {
+int64_t checkedCents(int64_t cents) {
+    if (cents > Money::kMaxCents || cents < -Money::kMaxCents) {
+        throw std::overflow_error("Amount out of range");
+    }
+    return cents;
+}
+}
+
+Money Money::fromCents(int64_t cents) {
+    return Money(checkedCents(cents));
+}
+
+// Both operands are within +/-kMaxCents, so the raw sum cannot overflow int64.
+Money Money::operator+(Money other) const {
+    return Money(checkedCents(cents_ + other.cents_));
+}
+
+Money Money::operator-(Money other) const {
+    return Money(checkedCents(cents_ - other.cents_));
+}
+
+Money& Money::operator+=(Money other) {
+    *this = *this + other;
+    return *this;
+}
+
+Money& Money::operator-=(Money other) {
+    *this = *this - other;
+    return *this;
+}
+
+bool parseMoney(const std::string& s, Money& out) {
+    size_t i = 0;
+    bool negative = false;
+    if (i < s.size() && s[i] == '-') {
+        negative = true;
+        ++i;
+    }
+
+    int64_t whole = 0;
+    size_t wholeDigits = 0;
+    while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+        whole = whole * 10 + (s[i] - '0');
+        if (whole > Money::kMaxCents / 100) return false;
+        ++wholeDigits;
+        ++i;
+    }
+
+    int64_t frac = 0;
+    size_t fracDigits = 0;
+    if (i < s.size() && s[i] == '.') {
+        ++i;
+        while (i < s.size() && s[i] >= '0' && s[i] <= '9') {
+            if (fracDigits == 2) return false;
+            frac = frac * 10 + (s[i] - '0');
+            ++fracDigits;
+            ++i;
+        }
+    }
+
+    if (i != s.size() || wholeDigits + fracDigits == 0) return false;
+    if (fracDigits == 1) frac *= 10;
+
+    int64_t cents = whole * 100 + frac;
+    out = Money::fromCents(negative ? -cents : cents);
+    return true;
+}
+
+void appendMoney(std::string& out, Money v) {
+    int64_t cents = v.cents();
+    if (cents < 0) {
+        out.push_back('-');
+        cents = -cents;
+    }
+
+    char digits[24];
+    size_t n = 0;
+    int64_t whole = cents / 100;
+    do {
+        digits[n++] = static_cast<char>('0' + whole % 10);
+        whole /= 10;
+    } while (whole > 0);
+    while (n > 0) out.push_back(digits[--n]);
+
+    out.push_back('.');
+    out.push_back(static_cast<char>('0' + (cents / 10) % 10));
+    out.push_back(static_cast<char>('0' + cents % 10));
+}
@@ -0,0 +1,44 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <cstdint>
+#include <string>
+
+// Exact currency amount in integer cents. Matches the NUMERIC(12,2) columns:
+// arithmetic that leaves that range throws std::overflow_error.
+// Travels to and from Postgres as int8 cents (see the *_cents columns in statements.cpp).
+class Money {
+public:
+    static const int64_t kMaxCents = 999999999999;  // 9,999,999,999.99
+
+    constexpr Money() : cents_(0) {}
+    static Money fromCents(int64_t cents);
+
+    int64_t cents() const { return cents_; }
+    bool isZero() const { return cents_ == 0; }
+    bool isPositive() const { return cents_ > 0; }
+
+    Money operator+(Money other) const;
+    Money operator-(Money other) const;
+    Money& operator+=(Money other);
+    Money& operator-=(Money other);
+
+    bool operator==(Money other) const { return cents_ == other.cents_; }
+    bool operator!=(Money other) const { return cents_ != other.cents_; }
+    bool operator<(Money other) const { return cents_ < other.cents_; }
+    bool operator<=(Money other) const { return cents_ <= other.cents_; }
+    bool operator>(Money other) const { return cents_ > other.cents_; }
+    bool operator>=(Money other) const { return cents_ >= other.cents_; }
+
+private:
+    explicit constexpr Money(int64_t cents) : cents_(cents) {}
+
+    int64_t cents_;
+};
+
+// Parses "12", "12.3" or "12.34" (optional leading '-'); rejects more than two decimals.
+bool parseMoney(const std::string& s, Money& out);
+// Appends "-1234.50"-style text without going through iostreams.
+void appendMoney(std::string& out, Money v);
+
+#endif // MONEY_H
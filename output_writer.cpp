@@ -0,0 +1,216 @@
+#include "output_writer.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define OUTPUT_WRITER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Escape sequences indexed by byte; null means the byte is copied as is.
+struct JsonEscapes {
+    const char* seq[256] = {};
+
+    constexpr JsonEscapes() {
+        seq[static_cast<unsigned char>('\\')] = "\\\\";
+        seq[static_cast<unsigned char>('"')] = "\\\"";
+        seq[static_cast<unsigned char>('\n')] = "\\n";
+        seq[static_cast<unsigned char>('\r')] = "\\r";
+        seq[static_cast<unsigned char>('\t')] = "\\t";
+    }
+};
+
+constexpr JsonEscapes kJsonEscapes;
+
+// Each scan returns the index of the first byte in p[0, n) that needs a JSON
+// escape, or n.
+size_t scanJsonScalar(const char* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (kJsonEscapes.seq[static_cast<unsigned char>(p[i])]) return i;
+    }
+    return n;
+}
+
+#ifdef OUTPUT_WRITER_X86
+size_t scanJsonSse2(const char* p, size_t n) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, cr)), _mm_cmpeq_epi8(v, tab)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    return i + scanJsonScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) size_t scanJsonAvx2(const char* p, size_t n) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, newline), _mm256_cmpeq_epi8(v, cr)), _mm256_cmpeq_epi8(v, tab)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+        if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+    }
+    // The tail stays in this function (VEX-encoded 16-byte step, then bytes):
+    // calling the SSE2 scan with dirty upper halves costs an AVX/SSE
+    // transition on every call.
+    if (i + 16 <= n) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(quote)), _mm_cmpeq_epi8(v, _mm256_castsi256_si128(backslash))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(newline)), _mm_cmpeq_epi8(v, _mm256_castsi256_si128(cr))),
+                         _mm_cmpeq_epi8(v, _mm256_castsi256_si128(tab))));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) return i + static_cast<size_t>(__builtin_ctz(mask));
+        i += 16;
+    }
+    return i + scanJsonScalar(p + i, n - i);
+}
+
+using ScanFn = size_t (*)(const char*, size_t);
+
+ScanFn pickJsonScan() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? scanJsonAvx2 : scanJsonSse2;
+}
+#endif
+
+size_t scanJson(const char* p, size_t n) {
+#ifdef OUTPUT_WRITER_X86
+    // Below one AVX2 block the wide registers only add setup.
+    static const ScanFn wide = pickJsonScan();
+    return n < 32 ? scanJsonSse2(p, n) : wide(p, n);
+#else
+    return scanJsonScalar(p, n);
+#endif
+}
+
+} // namespace
+
+void appendJsonEscaped(std::string& out, std::string_view s) {
+    const char* p = s.data();
+    size_t n = s.size();
+    while (n > 0) {
+        size_t clean = scanJson(p, n);
+        out.append(p, clean);
+        if (clean == n) return;
+        // Every escape is two bytes.
+        out.append(kJsonEscapes.seq[static_cast<unsigned char>(p[clean])], 2);
+        p += clean + 1;
+        n -= clean + 1;
+    }
+}
+
+// memchr is already vectorized by every C library worth using.
+void appendCsvEscaped(std::string& out, std::string_view s) {
+    const char* p = s.data();
+    size_t n = s.size();
+    while (n > 0) {
+        const void* hit = std::memchr(p, '"', n);
+        size_t clean = hit ? static_cast<size_t>(static_cast<const char*>(hit) - p) : n;
+        out.append(p, clean);
+        if (clean == n) return;
+        out.append("\"\"", 2);
+        p += clean + 1;
+        n -= clean + 1;
+    }
+}
+
+OutputWriter::OutputWriter(const std::string& path, size_t bufferSize)
+    : file_(path, std::ios::trunc | std::ios::binary), capacity_(bufferSize) {
+    buffer_.reserve(capacity_);
+}
+
+OutputWriter::~OutputWriter() {
+    flush();
+}
+
+bool OutputWriter::isOpen() const {
+    return file_.is_open();
+}
+
+bool OutputWriter::good() const {
+    return file_.good();
+}
+
+void OutputWriter::reserve(size_t n) {
+    if (buffer_.size() + n > capacity_) flush();
+}
+
+void OutputWriter::write(std::string_view s) {
+    if (s.size() >= capacity_) {
+        flush();
+        file_.write(s.data(), static_cast<std::streamsize>(s.size()));
+        flushed_ += s.size();
+        return;
+    }
+    reserve(s.size());
+    buffer_.append(s.data(), s.size());
+}
+
+void OutputWriter::put(char c) {
+    reserve(1);
+    buffer_.push_back(c);
+}
+
+void OutputWriter::writeInt(long long v) {
+    char digits[24];
+    size_t n = 0;
+    unsigned long long u = v < 0 ? 0ull - static_cast<unsigned long long>(v) : static_cast<unsigned long long>(v);
+    do {
+        digits[n++] = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    reserve(n + 1);
+    if (v < 0) buffer_.push_back('-');
+    while (n > 0) buffer_.push_back(digits[--n]);
+}
+
+// Both escapings at most double a slice, so a slice of capacity_ / 2 bytes
+// always fits the buffer after reserve() and appending never reallocates.
+void OutputWriter::writeEscaped(std::string_view s, void (*append)(std::string&, std::string_view)) {
+    size_t slice = capacity_ / 2 > 0 ? capacity_ / 2 : 1;
+    while (!s.empty()) {
+        std::string_view part = s.substr(0, slice);
+        reserve(2 * part.size());
+        append(buffer_, part);
+        s.remove_prefix(part.size());
+    }
+}
+
+void OutputWriter::writeCsvQuoted(std::string_view s) {
+    put('"');
+    writeEscaped(s, appendCsvEscaped);
+    put('"');
+}
+
+void OutputWriter::writeJsonEscaped(std::string_view s) {
+    writeEscaped(s, appendJsonEscaped);
+}
+
+void OutputWriter::flush() {
+    if (buffer_.empty()) return;
+    file_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    file_.flush();
+    flushed_ += buffer_.size();
+    buffer_.clear();
+}
+
+uint64_t OutputWriter::bytesWritten() const {
+    return flushed_ + buffer_.size();
+}
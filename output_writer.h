@@ -0,0 +1,54 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+// Appends s with the escaping of a JSON string body: backslash, double quote,
+// \n, \r and \t get a backslash escape, every other byte is copied as is.
+// The bytes that need escaping are found 16 (SSE2) or 32 (AVX2) at a time
+// and the clean runs between them are copied with one append each.
+void appendJsonEscaped(std::string& out, std::string_view s);
+// Appends s with embedded double quotes doubled (RFC 4180), without the
+// surrounding quotes.
+void appendCsvEscaped(std::string& out, std::string_view s);
+
+// Buffered file writer for exports: callers append fields, the writer hands
+// the file large blocks instead of one small write per field.
+class OutputWriter {
+public:
+    static const size_t kDefaultBufferSize = 1 << 20;
+
+    explicit OutputWriter(const std::string& path, size_t bufferSize = kDefaultBufferSize);
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    bool isOpen() const;
+    // False once any write to the file has failed (e.g. disk full).
+    bool good() const;
+    void write(std::string_view s);
+    void put(char c);
+    void writeInt(long long v);
+    // Wraps s in double quotes, doubling embedded quotes (RFC 4180).
+    void writeCsvQuoted(std::string_view s);
+    // appendJsonEscaped() straight into the buffer.
+    void writeJsonEscaped(std::string_view s);
+    void flush();
+
+    uint64_t bytesWritten() const;
+
+private:
+    void reserve(size_t n);
+    void writeEscaped(std::string_view s, void (*append)(std::string&, std::string_view));
+
+    std::ofstream file_;
+    std::string buffer_;
+    size_t capacity_;
+    uint64_t flushed_ = 0;
+};
+
+#endif // OUTPUT_WRITER_H
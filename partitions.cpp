@@ -0,0 +1,114 @@
+#include "partitions.h"
+#include "output_writer.h"
+#include "transaction.h"
+#include "utils.h"
+#include <iostream>
+#include <stdexcept>
+
+int ensureTransactionPartitions(pqxx::transaction_base& tx, int monthsAhead) {
+    pqxx::result res = tx.exec_params(
+        "SELECT ensure_transaction_partitions((now() AT TIME ZONE 'UTC')::date, "
+        "((now() AT TIME ZONE 'UTC') + make_interval(months => $1::int))::date)",
+        monthsAhead);
+    return res[0][0].as<int>();
+}
+
+std::vector<PartitionInfo> listTransactionPartitions(pqxx::connection& conn) {
+    pqxx::read_transaction tx(conn);
+    pqxx::result res = tx.exec(
+        "SELECT c.relname AS name, "
+        "CASE WHEN c.relname ~ '^transactions_[0-9]{4}_[0-9]{2}$' "
+        "     THEN replace(substr(c.relname, 14), '_', '-') ELSE '' END AS month, "
+        "GREATEST(c.reltuples, 0)::int8 AS rows, pg_total_relation_size(c.oid) AS bytes "
+        "FROM pg_inherits i JOIN pg_class c ON c.oid = i.inhrelid "
+        "WHERE i.inhparent = 'transactions'::regclass "
+        "ORDER BY c.relname");
+
+    std::vector<PartitionInfo> out;
+    out.reserve(res.size());
+    for (const auto& row : res) {
+        PartitionInfo p;
+        p.name = row["name"].c_str();
+        p.month = row["month"].c_str();
+        p.rows = row["rows"].as<int64_t>();
+        p.bytes = row["bytes"].as<int64_t>();
+        out.push_back(std::move(p));
+    }
+    return out;
+}
+
+namespace {
+
+// Streams one partition to CSV; returns the number of rows written.
+int64_t exportPartition(pqxx::connection& conn, const std::string& name, const std::string& path) {
+    OutputWriter csv(path);
+    if (!csv.isOpen()) throw std::runtime_error("Could not open " + path + " for writing");
+    csv.write("id,account_id,type,amount,counterparty,note,created_at\n");
+
+    // Old months no longer receive rows; the row count is re-checked at detach time.
+    pqxx::work tx(conn);
+    auto stream = pqxx::stream_from::query(tx,
+        "SELECT id, account_id, kind, amount::text, counterparty, note, created_at::text "
+        "FROM " + tx.quote_name(name) + " ORDER BY id");
+
+    int64_t rows = 0;
+    while (const std::vector<pqxx::zview>* row = stream.read_row()) {
+        csv.write((*row)[0]);
+        csv.put(',');
+        csv.write((*row)[1]);
+        csv.put(',');
+        // Archives keep kind names, so they stay readable without transaction_kinds.
+        csv.writeCsvQuoted(transactionKindName(parseTransactionKind((*row)[2])));
+        csv.put(',');
+        csv.write((*row)[3]);
+        csv.put(',');
+        csv.writeCsvQuoted((*row)[4].data() ? std::string_view((*row)[4]) : std::string_view());
+        csv.put(',');
+        csv.writeCsvQuoted((*row)[5].data() ? std::string_view((*row)[5]) : std::string_view());
+        csv.put(',');
+        csv.writeCsvQuoted((*row)[6]);
+        csv.put('\n');
+        ++rows;
+    }
+    stream.complete();
+    tx.commit();
+
+    csv.flush();
+    if (!csv.good()) throw std::runtime_error("Write to " + path + " failed");
+    return rows;
+}
+
+} // namespace
+
+size_t archiveTransactionPartitions(pqxx::connection& conn, int year, int month, const std::string& dir) {
+    std::string before = monthStartDate(year, month).substr(0, 7);
+    size_t archived = 0;
+
+    for (const PartitionInfo& p : listTransactionPartitions(conn)) {
+        // "YYYY-MM" strings compare in month order.
+        if (p.month.empty() || p.month >= before) continue;
+
+        std::string path = (dir.empty() ? std::string(".") : dir) + "/" + p.name + ".csv";
+        int64_t rows = exportPartition(conn, p.name, path);
+
+        // Detach takes a short exclusive lock on transactions; the export above ran without it.
+        pqxx::work tx(conn);
+        tx.exec("ALTER TABLE transactions DETACH PARTITION " + tx.quote_name(p.name));
+        int64_t now = tx.exec("SELECT count(*) FROM " + tx.quote_name(p.name))[0][0].as<int64_t>();
+        if (now != rows) {
+            throw std::runtime_error(p.name + " changed during export (" + std::to_string(rows) + " rows written, " +
+                                     std::to_string(now) + " now); nothing was detached");
+        }
+        tx.exec_params(
+            "INSERT INTO archived_partitions (month, row_count, archive_file) VALUES ($1::date, $2, $3) "
+            "ON CONFLICT (month) DO UPDATE SET row_count = archived_partitions.row_count + EXCLUDED.row_count, "
+            "archive_file = EXCLUDED.archive_file, archived_at = NOW()",
+            p.month + "-01", rows, path);
+        tx.exec("DROP TABLE " + tx.quote_name(p.name));
+        tx.commit();
+
+        std::cout << "Archived " << p.name << ": " << rows << " rows to " << path << ".\n";
+        ++archived;
+    }
+    return archived;
+}
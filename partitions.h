@@ -0,0 +1,31 @@
+#ifndef PARTITIONS_H
+#define PARTITIONS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <pqxx/pqxx>
+
+// transactions is range-partitioned by created_at into one table per month
+// (transactions_YYYY_MM) plus transactions_default, which catches rows for
+// months that have no partition yet.
+const int kPartitionMonthsAhead = 3;
+
+struct PartitionInfo {
+    std::string name;
+    std::string month;       // "YYYY-MM", empty for the default partition
+    int64_t rows = 0;        // planner estimate (reltuples)
+    int64_t bytes = 0;       // table + indexes
+};
+
+// Creates the partitions for the current month and monthsAhead after it;
+// rows already sitting in the default partition for those months are moved
+// into the new partition. Returns the number of partitions created.
+int ensureTransactionPartitions(pqxx::transaction_base& tx, int monthsAhead = kPartitionMonthsAhead);
+std::vector<PartitionInfo> listTransactionPartitions(pqxx::connection& conn);
+// Archives every monthly partition before year-month: writes its rows to
+// dir/transactions_YYYY_MM.csv, then detaches and drops it and records the
+// month in archived_partitions. Returns the number of partitions archived.
+size_t archiveTransactionPartitions(pqxx::connection& conn, int year, int month, const std::string& dir);
+
+#endif // PARTITIONS_H
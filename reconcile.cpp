@@ -0,0 +1,165 @@
+#include "reconcile.h"
+#include "statements.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Every worker imports the coordinator's snapshot into one of these.
+using SnapshotTransaction = pqxx::transaction<pqxx::isolation_level::repeatable_read, pqxx::write_policy::read_only>;
+
+struct ReconcileState {
+    const ReconcileOptions& options;
+    std::string snapshot;
+    long long first_id;
+    long long last_id;
+    std::atomic<long long> next_range{0};
+    std::atomic<size_t> ranges{0};
+    std::atomic<size_t> accounts{0};
+    std::atomic<size_t> mismatches{0};
+    std::atomic<uint64_t> ledger_rows{0};
+    std::mutex log_mutex;
+
+    ReconcileState(const ReconcileOptions& opts, const std::string& snap, long long first, long long last)
+        : options(opts), snapshot(snap), first_id(first), last_id(last) {}
+};
+
+// Either side of a mismatch may be outside Money's range, so no Money here.
+std::string formatCents(int64_t cents) {
+    std::string out = cents < 0 ? "-" : "";
+    uint64_t abs = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+    out += std::to_string(abs / 100);
+    out += '.';
+    out += static_cast<char>('0' + abs % 100 / 10);
+    out += static_cast<char>('0' + abs % 10);
+    return out;
+}
+
+void checkRange(pqxx::transaction_base& tx, ReconcileState& state, long long from_id, long long to_id) {
+    pqxx::result res = execStatement(tx, stmt::ReconcileRange, from_id, to_id);
+    uint64_t rows = 0;
+    for (const auto& row : res) {
+        rows += row["ledger_rows"].as<uint64_t>();
+        int64_t balance = row["balance_cents"].as<int64_t>();
+        int64_t ledger = row["ledger_cents"].as<int64_t>();
+        if (balance == ledger) continue;
+
+        state.mismatches += 1;
+        std::lock_guard<std::mutex> lock(state.log_mutex);
+        std::cout << "MISMATCH account " << row["id"].as<int>() << " (" << row["username"].as<std::string>()
+                  << "): balance " << formatCents(balance) << ", ledger " << formatCents(ledger)
+                  << ", difference " << formatCents(balance - ledger) << "\n";
+    }
+    state.accounts += res.size();
+    state.ledger_rows += rows;
+    state.ranges += 1;
+}
+
+void runWorker(Database& db, ReconcileState& state) {
+    long long from_id = 0;
+    bool resuming = false;
+    int reconnects = 0;
+
+    while (true) {
+        Database::Lease conn = db.acquire();
+        try {
+            // SET TRANSACTION SNAPSHOT must be the first statement of the transaction.
+            SnapshotTransaction tx(*conn);
+            tx.exec("SET TRANSACTION SNAPSHOT " + tx.quote(state.snapshot));
+            while (true) {
+                if (!resuming) {
+                    from_id = state.first_id + state.next_range.fetch_add(1) * state.options.range_ids;
+                    if (from_id > state.last_id) {
+                        tx.commit();
+                        return;
+                    }
+                }
+                resuming = true;
+                checkRange(tx, state, from_id, from_id + state.options.range_ids);
+                resuming = false;
+            }
+        } catch (const pqxx::broken_connection& ex) {
+            // The snapshot can be imported again for as long as the coordinator
+            // keeps its transaction open, so redo the range on a fresh connection.
+            conn.markBroken();
+            if (++reconnects > 3) throw;
+            std::lock_guard<std::mutex> lock(state.log_mutex);
+            std::cerr << "worker reconnecting: " << ex.what() << "\n";
+        }
+    }
+}
+
+} // namespace
+
+ReconcileResult runReconcile(Database& db, const ReconcileOptions& options) {
+    ReconcileResult result;
+
+    // Held until every worker is done: an exported snapshot stays importable
+    // only while the exporting transaction is open.
+    Database::Lease coordinator = db.acquire();
+    SnapshotTransaction tx(*coordinator);
+    std::string snapshot = tx.exec("SELECT pg_export_snapshot()")[0][0].as<std::string>();
+    pqxx::result bounds = tx.exec("SELECT COALESCE(MIN(id), 0), COALESCE(MAX(id), -1), COUNT(*) FROM accounts");
+    long long first_id = bounds[0][0].as<long long>();
+    long long last_id = bounds[0][1].as<long long>();
+    size_t total = bounds[0][2].as<size_t>();
+
+    std::cout << "Reconciling " << total << " accounts against the ledger with " << options.workers
+              << " workers (snapshot " << snapshot << ").\n";
+
+    auto started = std::chrono::steady_clock::now();
+    ReconcileState state(options, snapshot, first_id, last_id);
+    std::vector<std::thread> workers;
+    std::atomic<size_t> running{options.workers};
+    std::atomic<size_t> stopped{0};
+    for (size_t i = 0; i < options.workers; ++i) {
+        workers.emplace_back([&db, &state, &running, &stopped]() {
+            try {
+                runWorker(db, state);
+            } catch (const std::exception& ex) {
+                stopped += 1;
+                std::lock_guard<std::mutex> lock(state.log_mutex);
+                std::cerr << "worker stopped: " << ex.what() << "\n";
+            }
+            running -= 1;
+        });
+    }
+
+    while (running.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        std::lock_guard<std::mutex> lock(state.log_mutex);
+        std::cout << "  " << state.accounts.load() << "/" << total << " accounts, " << state.mismatches.load()
+                  << " mismatched, " << std::fixed << std::setprecision(0) << state.accounts.load() / elapsed
+                  << " accounts/s, " << state.ledger_rows.load() / elapsed << " ledger rows/s\n";
+    }
+    for (auto& t : workers) t.join();
+    tx.commit();
+
+    result.accounts = state.accounts.load();
+    result.mismatches = state.mismatches.load();
+    result.ranges = state.ranges.load();
+    result.ledger_rows = state.ledger_rows.load();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    if (stopped.load() > 0) {
+        throw std::runtime_error(std::to_string(stopped.load()) + " worker(s) stopped; only " +
+                                 std::to_string(result.accounts) + " of " + std::to_string(total) +
+                                 " accounts were checked");
+    }
+
+    double seconds = std::max(result.seconds, 1e-9);
+    std::cout << "Done: " << result.accounts << " accounts, " << result.ledger_rows << " ledger rows in "
+              << result.ranges << " ranges, " << result.mismatches << " mismatched, in " << std::fixed
+              << std::setprecision(2) << result.seconds << " s (" << std::setprecision(0)
+              << result.accounts / seconds << " accounts/s, " << result.ledger_rows / seconds << " rows/s).\n";
+    return result;
+}
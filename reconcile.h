@@ -0,0 +1,32 @@
+#ifndef RECONCILE_H
+#define RECONCILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include "database.h"
+
+struct ReconcileOptions {
+    size_t workers = 4;
+    long long range_ids = 10000;    // account ids per claimed range
+};
+
+struct ReconcileResult {
+    size_t accounts = 0;
+    size_t mismatches = 0;
+    size_t ranges = 0;
+    uint64_t ledger_rows = 0;
+    double seconds = 0.0;
+};
+
+// Checks every accounts.balance against the signed sum of its ledger rows,
+// classified by transaction_direction() as statements are. Months whose
+// partitions were archived are taken from monthly_totals instead.
+//
+// A coordinator transaction exports its snapshot and stays open until the
+// end; each worker imports it into a REPEATABLE READ transaction on its own
+// pooled connection, so all ranges see the same committed state. Workers claim
+// account id ranges one at a time and print each mismatch as it is found. The
+// pool must have options.workers + 1 connections.
+ReconcileResult runReconcile(Database& db, const ReconcileOptions& options);
+
+#endif // RECONCILE_H
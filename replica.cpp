@@ -0,0 +1,98 @@
+#include "replica.h"
+#include <cstdlib>
+#include <limits>
+
+const std::chrono::milliseconds ReadRouter::kRecheckInterval(1000);
+
+uint64_t parseLsn(const std::string& text) {
+    size_t slash = text.find('/');
+    if (slash == std::string::npos || slash == 0 || slash + 1 >= text.size()) return 0;
+    char* end = nullptr;
+    uint64_t hi = std::strtoull(text.c_str(), &end, 16);
+    if (end != text.c_str() + slash) return 0;
+    uint64_t lo = std::strtoull(text.c_str() + slash + 1, &end, 16);
+    if (*end != '\0') return 0;
+    return (hi << 32) | lo;
+}
+
+ReadRouter::ReadRouter(const std::string& replicaConnStr, size_t poolSize, int64_t maxLagMs)
+    : replica_(replicaConnStr, poolSize), maxLagMs_(maxLagMs) {}
+
+// Lag is zero while the replica has replayed everything it received; the
+// replay timestamp alone would grow on an idle primary.
+void ReadRouter::check(pqxx::connection& conn) {
+    pqxx::nontransaction tx(conn);
+    pqxx::result res = tx.exec(
+        "SELECT pg_is_in_recovery() AS standby, COALESCE(pg_last_wal_replay_lsn()::text, '0/0') AS replayed, "
+        "CASE WHEN pg_last_wal_receive_lsn() IS NOT DISTINCT FROM pg_last_wal_replay_lsn() THEN 0 "
+        "ELSE COALESCE((EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()) * 1000)::int8, 0) END AS lag_ms");
+    bool standby = res[0]["standby"].as<bool>();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    checked_ = true;
+    checkedAt_ = Clock::now();
+    replayed_ = standby ? parseLsn(res[0]["replayed"].as<std::string>()) : std::numeric_limits<uint64_t>::max();
+    stats_.lag_ms = standby ? res[0]["lag_ms"].as<int64_t>() : 0;
+    stats_.checks += 1;
+}
+
+std::optional<Database::Lease> ReadRouter::acquire(uint64_t lsn) {
+    bool recheck = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (checked_ && Clock::now() - checkedAt_ < kRecheckInterval) {
+            if (stats_.lag_ms > maxLagMs_) {
+                stats_.lag_fallbacks += 1;
+                return std::nullopt;
+            }
+            // Behind the session's writes: worth asking again, it may have caught up.
+            recheck = replayed_ < lsn;
+        }
+    }
+
+    try {
+        Database::Lease conn = replica_.acquire();
+        if (recheck) check(*conn);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stats_.lag_ms > maxLagMs_) {
+            stats_.lag_fallbacks += 1;
+        } else if (replayed_ < lsn) {
+            stats_.behind_fallbacks += 1;
+        } else {
+            stats_.replica_reads += 1;
+            return std::optional<Database::Lease>(std::move(conn));
+        }
+    } catch (const std::exception&) {
+        // Counted, not printed: this runs on job threads under the menu.
+        // Forget the last check so the next read tries the replica again.
+        std::lock_guard<std::mutex> lock(mutex_);
+        checked_ = false;
+        stats_.error_fallbacks += 1;
+    }
+    return std::nullopt;
+}
+
+void ReadRouter::countReadFailure() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    checked_ = false;
+    stats_.error_fallbacks += 1;
+}
+
+ReadRouterStats ReadRouter::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+ReadRoute ReadSession::route() {
+    if (!router_) return ReadRoute();
+    if (dirty_) {
+        pqxx::nontransaction tx(primary_);
+        lsn_ = parseLsn(tx.exec("SELECT pg_current_wal_insert_lsn()::text")[0][0].as<std::string>());
+        dirty_ = false;
+    }
+    ReadRoute route;
+    route.router = router_;
+    route.lsn = lsn_;
+    return route;
+}
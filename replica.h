@@ -0,0 +1,121 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <pqxx/pqxx>
+#include "database.h"
+
+struct ReadRouterStats {
+    uint64_t replica_reads = 0;
+    uint64_t behind_fallbacks = 0;    // replica had not replayed the session's own writes yet
+    uint64_t lag_fallbacks = 0;       // replica lagged more than the configured bound
+    uint64_t error_fallbacks = 0;     // replica unreachable, or a read broke off or was cancelled
+    uint64_t checks = 0;
+    int64_t lag_ms = 0;               // as of the last check
+};
+
+// Optional read replica behind the pure reads (history pages, exports and the
+// reads of statement generation). A read is sent to the replica only when it
+// has replayed the primary's WAL up to the position the read asks for (see
+// ReadSession) and lags at most maxLagMs; otherwise it runs on the primary.
+//
+// Replay position and lag are checked on a replica connection at most once per
+// kRecheckInterval; reads in between rely on the last check, since replay only
+// moves forward. A replica URL that points at a primary is always caught up.
+class ReadRouter {
+public:
+    static const int64_t kDefaultMaxLagMs = 1000;
+    static const std::chrono::milliseconds kRecheckInterval;
+
+    ReadRouter(const std::string& replicaConnStr, size_t poolSize, int64_t maxLagMs = kDefaultMaxLagMs);
+
+    ReadRouter(const ReadRouter&) = delete;
+    ReadRouter& operator=(const ReadRouter&) = delete;
+
+    // A replica connection that may serve a read needing WAL position lsn, or
+    // nothing when the read must go to the primary.
+    std::optional<Database::Lease> acquire(uint64_t lsn);
+    // A replica read broke off; it is redone on the primary.
+    void countReadFailure();
+    ReadRouterStats stats() const;
+    PoolStats poolStats() const { return replica_.poolStats(); }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void check(pqxx::connection& conn);
+
+    Database replica_;
+    int64_t maxLagMs_;
+    mutable std::mutex mutex_;
+    bool checked_ = false;
+    Clock::time_point checkedAt_;
+    uint64_t replayed_ = 0;
+    ReadRouterStats stats_;
+};
+
+// Where a read may run: a replica that has replayed lsn, else the primary.
+// The default route always uses the primary.
+struct ReadRoute {
+    ReadRouter* router = nullptr;
+    uint64_t lsn = 0;
+};
+
+// Runs read(conn) on a replica connection when the route allows it, and on
+// primary otherwise. A replica read that loses its connection, or that the
+// standby cancels for a conflict with recovery (SQLSTATE 40001, the usual
+// end of a long export while replay removes rows it still needs), is redone
+// on the primary, so read must not have side effects outside the database
+// that a second run would duplicate.
+template <typename Read>
+auto routeRead(const ReadRoute& route, pqxx::connection& primary, Read&& read) -> decltype(read(primary)) {
+    if (route.router) {
+        std::optional<Database::Lease> replica = route.router->acquire(route.lsn);
+        if (replica) {
+            try {
+                return read(**replica);
+            } catch (const pqxx::broken_connection&) {
+                replica->markBroken();
+                replica.reset();
+                route.router->countReadFailure();
+            } catch (const pqxx::transaction_rollback&) {
+                replica.reset();
+                route.router->countReadFailure();
+            }
+        }
+    }
+    return read(primary);
+}
+
+// Read-your-writes for one session on the primary: after noteWrite(), the
+// next route() asks the primary for its WAL insert position, which covers
+// every commit the session made, and routes reads to replicas that have
+// replayed that far. Sessions that never write never ask.
+class ReadSession {
+public:
+    ReadSession(ReadRouter* router, pqxx::connection& primary) : router_(router), primary_(primary) {}
+
+    void noteWrite() { dirty_ = true; }
+    ReadRoute route();
+
+    template <typename Read>
+    auto read(Read&& r) -> decltype(r(std::declval<pqxx::connection&>())) {
+        return routeRead(route(), primary_, std::forward<Read>(r));
+    }
+
+private:
+    ReadRouter* router_;
+    pqxx::connection& primary_;
+    bool dirty_ = false;
+    uint64_t lsn_ = 0;
+};
+
+// "16/B374D848" -> 0x16B374D848; 0 for anything unparsable.
+uint64_t parseLsn(const std::string& text);
+
+#endif // REPLICA_H
@@ -0,0 +1,707 @@
+#include "server.h"
+#include "account.h"
+#include "metrics.h"
+#include "transaction.h"
+#include "transfer.h"
+#include "utils.h"
+#include <iostream>
+
+#if defined(__linux__)
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const size_t kMaxLineBytes = 4096;
+const size_t kMaxBufferedInput = 64 * 1024;
+const int kTickMs = 1000;
+const int kMaxEvents = 256;
+
+std::atomic<bool> stopRequested{false};
+
+void onStopSignal(int) {
+    stopRequested.store(true);
+}
+
+// What a request may know about its session. Copied into the worker so the
+// session itself is only ever touched by its event loop.
+struct SessionView {
+    int account_id = 0;
+    std::string username;
+};
+
+struct Reply {
+    enum class Auth { Keep, Login };
+
+    std::string text;             // newline-terminated
+    Auth auth = Auth::Keep;
+    SessionView session;          // for Auth::Login
+};
+
+struct ServerContext {
+    Database& db;
+    LoginLogWriter& loginLog;
+    JobScheduler& jobs;
+    JobScheduler& requests;
+    AsyncExecutor* async;
+    const ServerOptions& options;
+    std::atomic<uint64_t> nextSessionId{1};
+};
+
+std::vector<std::string> splitWords(const std::string& line) {
+    std::vector<std::string> words;
+    std::istringstream in(line);
+    std::string w;
+    while (in >> w) words.push_back(w);
+    return words;
+}
+
+std::string upper(std::string s) {
+    for (char& c : s) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    return s;
+}
+
+// Row fields are tab-separated, so tabs and line breaks inside them become spaces.
+std::string field(const std::string& s) {
+    std::string out = s;
+    for (char& c : out) {
+        if (c == '\t' || c == '\n' || c == '\r') c = ' ';
+    }
+    return out;
+}
+
+Reply ok(const std::string& rest = "") {
+    Reply r;
+    r.text = rest.empty() ? "OK\n" : "OK " + rest + "\n";
+    return r;
+}
+
+Reply err(const std::string& code) {
+    Reply r;
+    r.text = "ERR " + code + "\n";
+    return r;
+}
+
+Reply handleCreate(pqxx::connection& conn, const std::vector<std::string>& words) {
+    ActionTimer action("server.create");
+    if (words.size() < 3 || words.size() > 4) return err("usage CREATE user pin [amount]");
+    const std::string& username = words[1];
+    const std::string& pin = words[2];
+    if (!isValidUsername(username)) return err("invalid-username");
+    if (!isValidPin(pin)) return err("invalid-pin");
+    Money initial;
+    if (words.size() == 4 && !parseAmount(words[3], initial)) return err("invalid-amount");
+
+    std::string salt = generateSalt();
+    int new_id = 0;
+    try {
+        new_id = createAccount(conn, username, hashPin(pin, salt), salt, initial);
+    } catch (const pqxx::unique_violation&) {
+        return err("username-taken");
+    }
+    return ok(std::to_string(new_id));
+}
+
+Reply handleLogin(pqxx::connection& conn, LoginLogWriter& loginLog, const std::vector<std::string>& words) {
+    ActionTimer action("server.login");
+    if (words.size() != 3) return err("usage LOGIN user pin");
+    LoginResult login = authenticate(conn, words[1], words[2], nowSeconds());
+    if (login.status != LoginStatus::UnknownUser) {
+        loginLog.record(login.account.id, login.status == LoginStatus::Ok);
+    }
+
+    switch (login.status) {
+        case LoginStatus::UnknownUser: return err("invalid-login");
+        case LoginStatus::Locked: return err("locked " + std::to_string(login.lock_remaining));
+        case LoginStatus::LockedOut: return err("locked-out " + std::to_string(kLockSeconds));
+        case LoginStatus::BadPin: return err("bad-pin " + std::to_string(login.attempts_left));
+        case LoginStatus::Ok: break;
+    }
+    Reply r = ok(formatMoney(login.account.balance));
+    r.auth = Reply::Auth::Login;
+    r.session.account_id = login.account.id;
+    r.session.username = login.account.username;
+    return r;
+}
+
+Reply handleHistory(pqxx::connection& conn, const SessionView& session, const std::vector<std::string>& words) {
+    ActionTimer action("server.history");
+    HistoryPage page;
+    if (words.size() == 1) {
+        page = fetchHistoryPage(conn, session.account_id, 0, HistoryDirection::Older);
+    } else if (words.size() == 3) {
+        long long anchor = 0;
+        try {
+            anchor = std::stoll(words[2]);
+        } catch (...) {
+            return err("invalid-anchor");
+        }
+        std::string dir = upper(words[1]);
+        if (dir == "OLDER") {
+            page = fetchHistoryPage(conn, session.account_id, anchor, HistoryDirection::Older);
+        } else if (dir == "NEWER") {
+            page = fetchHistoryPage(conn, session.account_id, anchor, HistoryDirection::Newer);
+        } else {
+            return err("usage HISTORY [OLDER|NEWER anchor_id]");
+        }
+    } else {
+        return err("usage HISTORY [OLDER|NEWER anchor_id]");
+    }
+
+    Reply r = ok(std::to_string(page.entries.size()) + " " + (page.has_older ? "1" : "0") + " " + (page.has_newer ? "1" : "0"));
+    for (const auto& e : page.entries) {
+        r.text += std::to_string(e.id) + "\t" + field(e.created_at) + "\t" + field(transactionKindName(e.kind)) + "\t" + formatMoney(e.amount)
+                + "\t" + field(e.counterparty) + "\t" + field(e.note) + "\n";
+    }
+    return r;
+}
+
+// Checks done before a transfer is sent to the database, on either path.
+bool checkTransfer(const SessionView& session, const std::vector<std::string>& words, Reply& invalid) {
+    if (words[1] == session.username) {
+        invalid = err("self-transfer");
+        return false;
+    }
+    if (!isValidUsername(words[1])) {
+        invalid = err("recipient-not-found");
+        return false;
+    }
+    return true;
+}
+
+Reply transferReply(TransferStatus status, Money balance) {
+    switch (status) {
+        case TransferStatus::RecipientNotFound: return err("recipient-not-found");
+        case TransferStatus::InsufficientFunds: return err("insufficient-funds");
+        case TransferStatus::Aborted: return err("contention");
+        case TransferStatus::Ok: break;
+    }
+    return ok(formatMoney(balance));
+}
+
+// Runs on a request worker.
+Reply handleRequest(pqxx::connection& conn, ServerContext& ctx, const SessionView& session, const std::vector<std::string>& words) {
+    std::string cmd = upper(words[0]);
+    if (cmd == "CREATE") return handleCreate(conn, words);
+    if (cmd == "LOGIN") return handleLogin(conn, ctx.loginLog, words);
+    if (cmd == "HISTORY") return handleHistory(conn, session, words);
+
+    if (cmd == "BALANCE") {
+        ActionTimer action("server.balance");
+        Account acc;
+        if (!fetchAccountById(conn, session.account_id, acc)) return err("account-not-found");
+        return ok(formatMoney(acc.balance));
+    }
+
+    Money amount;
+    if (cmd == "DEPOSIT" || cmd == "WITHDRAW") {
+        if (words.size() != 2) return err("usage " + cmd + " amount");
+        if (!parseAmount(words[1], amount)) return err("invalid-amount");
+    } else if (cmd == "TRANSFER" || cmd == "FAKE") {
+        if (words.size() != 3) return err("usage " + cmd + " user amount");
+        if (!parseAmount(words[2], amount)) return err("invalid-amount");
+    }
+
+    Money balance;
+    if (cmd == "DEPOSIT") {
+        ActionTimer action("server.deposit");
+        depositFunds(conn, session.account_id, amount, balance);
+        return ok(formatMoney(balance));
+    }
+    if (cmd == "WITHDRAW") {
+        ActionTimer action("server.withdraw");
+        if (!withdrawFunds(conn, session.account_id, amount, balance)) return err("insufficient-funds");
+        return ok(formatMoney(balance));
+    }
+    if (cmd == "TRANSFER") {
+        ActionTimer action("server.transfer");
+        Reply invalid;
+        if (!checkTransfer(session, words, invalid)) return invalid;
+        return transferReply(transferFunds(conn, session.account_id, words[1], amount, balance), balance);
+    }
+    if (cmd == "FAKE") {
+        ActionTimer action("server.fake_transfer");
+        pqxx::work tx(conn);
+        recordTransaction(tx, session.account_id, TransactionKind::FakeTransfer, amount, words[1], "simulated only, no balance moved");
+        tx.commit();
+        return ok();
+    }
+    return err("unknown-command");
+}
+
+bool isDatabaseCommand(const std::string& cmd) {
+    return cmd == "CREATE" || cmd == "LOGIN" || cmd == "BALANCE" || cmd == "DEPOSIT" || cmd == "WITHDRAW"
+        || cmd == "TRANSFER" || cmd == "FAKE" || cmd == "HISTORY";
+}
+
+bool needsLogin(const std::string& cmd) {
+    return cmd != "PING" && cmd != "CREATE" && cmd != "LOGIN" && cmd != "QUIT";
+}
+
+// One epoll instance and the sessions it accepted. All session state is owned
+// by the loop thread; workers hand replies back through post() and an eventfd.
+class EventLoop {
+public:
+    EventLoop(ServerContext& ctx, int listenFd) : ctx_(ctx), listenFd_(listenFd) {
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epfd_ < 0 || wakeFd_ < 0) throw std::runtime_error("epoll setup failed");
+
+        // EPOLLEXCLUSIVE: a new connection wakes one loop, not all of them.
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.fd = listenFd_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, listenFd_, &ev);
+        ev.events = EPOLLIN;
+        ev.data.fd = wakeFd_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, wakeFd_, &ev);
+    }
+
+    ~EventLoop() {
+        for (auto& entry : sessions_) ::close(entry.first);
+        ::close(wakeFd_);
+        ::close(epfd_);
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void run() {
+        epoll_event events[kMaxEvents];
+        while (!stopRequested.load()) {
+            int n = epoll_wait(epfd_, events, kMaxEvents, kTickMs);
+            if (n < 0 && errno != EINTR) break;
+            for (int i = 0; i < n; ++i) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd_) {
+                    acceptAll();
+                } else if (fd == wakeFd_) {
+                    drainReplies();
+                } else {
+                    onSessionEvent(fd, events[i].events);
+                }
+            }
+            closeIdleSessions();
+        }
+    }
+
+    size_t sessionCount() const {
+        return sessionCount_.load();
+    }
+
+    // Called from request workers.
+    void post(int fd, uint64_t sessionId, Reply reply) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            replies_.push_back(Completed{fd, sessionId, std::move(reply)});
+        }
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeFd_, &one, sizeof(one));
+        (void)ignored;
+    }
+
+private:
+    struct Session {
+        uint64_t id = 0;
+        std::string in;
+        std::string out;
+        SessionView view;
+        std::vector<uint64_t> jobs;
+        bool busy = false;           // a request is with the workers
+        bool closing = false;        // close once out is flushed
+        bool inputClosed = false;    // peer shut down its side; answer what was sent, then close
+        uint32_t events = EPOLLIN | EPOLLRDHUP;
+        Clock::time_point lastActive;
+    };
+
+    struct Completed {
+        int fd;
+        uint64_t sessionId;
+        Reply reply;
+    };
+
+    void acceptAll() {
+        while (true) {
+            int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) return;
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+            Session& s = sessions_[fd];
+            s = Session();
+            s.id = ctx_.nextSessionId.fetch_add(1);
+            s.lastActive = Clock::now();
+            sessionCount_.store(sessions_.size());
+
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.fd = fd;
+            epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    void onSessionEvent(int fd, uint32_t events) {
+        auto it = sessions_.find(fd);
+        if (it == sessions_.end()) return;
+        Session& s = it->second;
+
+        if (events & (EPOLLERR | EPOLLHUP)) {
+            closeSession(fd);
+            return;
+        }
+        if (events & EPOLLOUT) {
+            if (!flush(fd, s)) return;
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP)) {
+            char buf[16384];
+            while (true) {
+                ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+                if (n > 0) {
+                    s.in.append(buf, static_cast<size_t>(n));
+                    if (s.in.size() > kMaxBufferedInput) {
+                        closeSession(fd);
+                        return;
+                    }
+                    continue;
+                }
+                if (n == 0) {
+                    s.inputClosed = true;
+                    break;
+                }
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+                // Reset by the peer; a reply still in flight is dropped by drainReplies().
+                closeSession(fd);
+                return;
+            }
+            s.lastActive = Clock::now();
+            processInput(fd, s);
+            flush(fd, s);
+        }
+    }
+
+    void processInput(int fd, Session& s) {
+        while (!s.busy && !s.closing) {
+            size_t nl = s.in.find('\n');
+            if (nl == std::string::npos) {
+                if (s.in.size() > kMaxLineBytes) {
+                    s.out += "ERR line-too-long\n";
+                    s.closing = true;
+                }
+                break;
+            }
+            std::string line = s.in.substr(0, nl);
+            s.in.erase(0, nl + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            dispatch(fd, s, line);
+        }
+        if (s.inputClosed && !s.busy) s.closing = true;
+    }
+
+    void dispatch(int fd, Session& s, const std::string& line) {
+        std::vector<std::string> words = splitWords(line);
+        if (words.empty()) return;
+        std::string cmd = upper(words[0]);
+
+        if (needsLogin(cmd) && s.view.account_id == 0) {
+            s.out += "ERR not-logged-in\n";
+            return;
+        }
+        if (cmd == "PING") {
+            s.out += "OK pong\n";
+        } else if (cmd == "QUIT") {
+            s.out += "BYE\n";
+            s.closing = true;
+        } else if (cmd == "LOGOUT") {
+            s.view = SessionView();
+            s.jobs.clear();
+            s.out += "OK\n";
+        } else if (cmd == "EXPORT" || cmd == "STATEMENT") {
+            submitJob(s, cmd, words);
+        } else if (cmd == "JOBS") {
+            listJobs(s);
+        } else if (cmd == "TRANSFER" && ctx_.async) {
+            submitAsyncTransfer(fd, s, words);
+        } else if (isDatabaseCommand(cmd)) {
+            submitRequest(fd, s, cmd, std::move(words));
+        } else {
+            s.out += "ERR unknown-command\n";
+        }
+    }
+
+    void submitRequest(int fd, Session& s, const std::string& cmd, std::vector<std::string> words) {
+        EventLoop* loop = this;
+        ServerContext* ctx = &ctx_;
+        uint64_t sessionId = s.id;
+        SessionView view = s.view;
+        uint64_t id = ctx_.requests.trySubmit(cmd, [loop, ctx, fd, sessionId, view, words](pqxx::connection& conn) {
+            Reply reply;
+            try {
+                reply = handleRequest(conn, *ctx, view, words);
+            } catch (const pqxx::broken_connection&) {
+                throw; // the worker drops the connection; answered below
+            } catch (const std::exception& ex) {
+                reply = err("internal " + field(ex.what()));
+            }
+            loop->post(fd, sessionId, std::move(reply));
+        }, [loop, fd, sessionId](const std::string&) {
+            loop->post(fd, sessionId, err("database-unavailable"));
+        });
+        if (id == 0) {
+            s.out += "ERR busy\n";
+            return;
+        }
+        s.busy = true;
+    }
+
+    // Sent straight from the loop thread: no worker is tied up while the
+    // statement is on the wire, and the reply is posted back like any other.
+    void submitAsyncTransfer(int fd, Session& s, const std::vector<std::string>& words) {
+        Money amount;
+        Reply invalid;
+        if (words.size() != 3) {
+            invalid = err("usage TRANSFER user amount");
+        } else if (!parseAmount(words[2], amount)) {
+            invalid = err("invalid-amount");
+        } else {
+            checkTransfer(s.view, words, invalid);
+        }
+        if (!invalid.text.empty()) {
+            s.out += invalid.text;
+            return;
+        }
+
+        EventLoop* loop = this;
+        uint64_t sessionId = s.id;
+        auto started = Clock::now();
+        transferFundsAsync(*ctx_.async, s.view.account_id, words[1], amount, [loop, fd, sessionId, started](const AsyncTransferResult& r) {
+            uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count());
+            static const int metric = metricId("server.transfer_async");
+            recordMetric(metric, ns, ns);
+            loop->post(fd, sessionId, r.error.empty() ? transferReply(r.status, r.new_balance) : err("internal " + field(r.error)));
+        });
+        s.busy = true;
+    }
+
+    void submitJob(Session& s, const std::string& cmd, const std::vector<std::string>& words) {
+        Account acc;
+        acc.id = s.view.account_id;
+        acc.username = s.view.username;
+        uint64_t id = 0;
+        if (cmd == "EXPORT") {
+            id = ctx_.jobs.trySubmit("export " + acc.username, [acc](pqxx::connection& jobConn) {
+                ActionTimer action("job.export_history");
+                exportHistory(jobConn, acc);
+            });
+        } else {
+            int year = 0;
+            int month = 0;
+            if (words.size() == 1) {
+                currentYearMonth(year, month);
+            } else if (words.size() != 2 || !parseYearMonth(words[1], year, month)) {
+                s.out += "ERR usage STATEMENT [YYYY-MM]\n";
+                return;
+            }
+            id = ctx_.jobs.trySubmit("statement " + monthStartDate(year, month).substr(0, 7), [acc, year, month](pqxx::connection& jobConn) {
+                ActionTimer action("job.monthly_statement");
+                // The ending balance is read when the job runs, not when it was queued.
+                Account current;
+                if (!fetchAccountById(jobConn, acc.id, current, AccountRead::Fresh)) throw std::runtime_error("Account not found");
+                generateMonthlyStatement(jobConn, current, year, month);
+            });
+        }
+        if (id == 0) {
+            s.out += "ERR queue-full\n";
+            return;
+        }
+        s.jobs.push_back(id);
+        s.out += "OK " + std::to_string(id) + "\n";
+    }
+
+    void listJobs(Session& s) {
+        std::string rows;
+        size_t n = 0;
+        for (uint64_t id : s.jobs) {
+            JobStatus st;
+            if (!ctx_.jobs.status(id, st)) continue;
+            ++n;
+            rows += std::to_string(st.id) + "\t" + field(st.name) + "\t" + jobStateName(st.state) + "\t"
+                  + std::to_string(static_cast<long long>(st.run_ms)) + "\t" + field(st.error) + "\n";
+        }
+        s.out += "OK " + std::to_string(n) + "\n" + rows;
+    }
+
+    void drainReplies() {
+        uint64_t count = 0;
+        ssize_t ignored = ::read(wakeFd_, &count, sizeof(count));
+        (void)ignored;
+
+        std::vector<Completed> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready.swap(replies_);
+        }
+        for (Completed& c : ready) {
+            auto it = sessions_.find(c.fd);
+            if (it == sessions_.end() || it->second.id != c.sessionId) continue;
+            Session& s = it->second;
+            if (c.reply.auth == Reply::Auth::Login) {
+                s.view = c.reply.session;
+                s.jobs.clear();
+            }
+            s.out += c.reply.text;
+            s.busy = false;
+            s.lastActive = Clock::now();
+            processInput(c.fd, s);
+            flush(c.fd, s);
+        }
+    }
+
+    // Returns false if the session was closed.
+    bool flush(int fd, Session& s) {
+        while (!s.out.empty()) {
+            ssize_t n = ::send(fd, s.out.data(), s.out.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                s.out.erase(0, static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            closeSession(fd);
+            return false;
+        }
+
+        bool want = !s.out.empty();
+        uint32_t events = (s.inputClosed ? 0u : static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP))
+                        | (want ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+        if (events != s.events) {
+            s.events = events;
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = fd;
+            epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev);
+        }
+        if (!want && s.closing) {
+            closeSession(fd);
+            return false;
+        }
+        return true;
+    }
+
+    void closeIdleSessions() {
+        Clock::time_point cutoff = Clock::now() - std::chrono::seconds(ctx_.options.idle_timeout_seconds);
+        std::vector<int> idle;
+        for (auto& entry : sessions_) {
+            const Session& s = entry.second;
+            if (!s.busy && !s.closing && s.lastActive < cutoff) idle.push_back(entry.first);
+        }
+        for (int fd : idle) {
+            Session& s = sessions_[fd];
+            s.out += "BYE idle-timeout\n";
+            s.closing = true;
+            flush(fd, s);
+        }
+    }
+
+    void closeSession(int fd) {
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        sessions_.erase(fd);
+        sessionCount_.store(sessions_.size());
+    }
+
+    ServerContext& ctx_;
+    int listenFd_;
+    int epfd_ = -1;
+    int wakeFd_ = -1;
+    std::unordered_map<int, Session> sessions_;
+    std::atomic<size_t> sessionCount_{0};
+    std::mutex mutex_;
+    std::vector<Completed> replies_;
+};
+
+int openListener(const ServerOptions& options) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1
+        || ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+        || ::listen(fd, SOMAXCONN) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+bool runServer(Database& db, LoginLogWriter& loginLog, JobScheduler& jobs, AsyncExecutor* async, const ServerOptions& options) {
+    int listenFd = openListener(options);
+    if (listenFd < 0) {
+        std::cout << "Could not listen on " << options.host << ":" << options.port << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    JobScheduler requests(db, options.db_workers, options.request_queue);
+    ServerContext ctx{db, loginLog, jobs, requests, async, options};
+
+    std::vector<std::unique_ptr<EventLoop>> loops;
+    for (size_t i = 0; i < std::max<size_t>(options.event_loops, 1); ++i) {
+        loops.emplace_back(new EventLoop(ctx, listenFd));
+    }
+    std::vector<std::thread> threads;
+    for (auto& loop : loops) {
+        threads.emplace_back(&EventLoop::run, loop.get());
+    }
+
+    std::cout << "Listening on " << options.host << ":" << options.port << " (" << loops.size() << " event loops, "
+              << options.db_workers << " database workers). Ctrl+C to stop.\n";
+    for (auto& t : threads) t.join();
+
+    // Loops stay alive until in-flight requests have posted their replies.
+    requests.shutdown();
+    if (async) async->waitIdle();
+    size_t open = 0;
+    for (const auto& loop : loops) open += loop->sessionCount();
+    loops.clear();
+    ::close(listenFd);
+    std::cout << "Server stopped; closed " << open << " session(s).\n";
+    return true;
+}
+
+#else
+
+bool runServer(Database&, LoginLogWriter&, JobScheduler&, AsyncExecutor*, const ServerOptions&) {
+    std::cout << "Server mode needs Linux (epoll).\n";
+    return false;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstddef>
+#include <string>
+#include "async_executor.h"
+#include "database.h"
+#include "job_scheduler.h"
+#include "login_log.h"
+
+struct ServerOptions {
+    std::string host = "127.0.0.1";
+    int port = 7400;
+    size_t event_loops = 2;
+    size_t db_workers = 4;            // each holds one pooled connection
+    size_t request_queue = 4096;      // requests waiting for a worker before ERR busy
+    int idle_timeout_seconds = 300;
+    size_t pipelined_connections = 0;  // > 0: TRANSFER goes through an AsyncExecutor
+};
+
+// Line protocol: one request per line, words separated by spaces, amounts as 12.34.
+// Every reply is one line starting with OK, ERR <code> or BYE, except HISTORY
+// and JOBS, which answer "OK <n> ..." followed by n tab-separated rows.
+//
+//   PING                      CREATE user pin [amount]    LOGIN user pin
+//   BALANCE                   DEPOSIT amount              WITHDRAW amount
+//   TRANSFER user amount      FAKE user amount            HISTORY [OLDER|NEWER anchor_id]
+//   EXPORT                    STATEMENT [YYYY-MM]         JOBS
+//   LOGOUT                    QUIT
+//
+// A session runs one request at a time; lines sent meanwhile wait in its buffer.
+// Sessions idle for idle_timeout_seconds are closed with "BYE idle-timeout".
+// With async, transfers skip the worker pool and are pipelined straight from
+// the event loops. Runs until SIGINT/SIGTERM; returns false if the listener
+// cannot be set up. Linux only (epoll).
+bool runServer(Database& db, LoginLogWriter& loginLog, JobScheduler& jobs, AsyncExecutor* async, const ServerOptions& options);
+
+#endif // SERVER_H
@@ -0,0 +1,180 @@
+#include "statements.h"
+#include "transaction.h"
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+struct StatementDef {
+    const char* name;
+    std::string sql;
+};
+
+// A TransactionKind as a SQL literal for transactions.kind.
+std::string kindSql(TransactionKind kind) {
+    return std::to_string(static_cast<int>(kind)) + "::int2";
+}
+
+const StatementDef kStatements[] = {
+    {stmt::FetchAccountByUsername,
+     "SELECT id, username, pin_hash, salt, (balance * 100)::int8 AS balance_cents, failed_attempts, locked_until "
+     "FROM accounts WHERE username = $1"},
+    {stmt::FetchAccountById,
+     "SELECT id, username, pin_hash, salt, (balance * 100)::int8 AS balance_cents, failed_attempts, locked_until "
+     "FROM accounts WHERE id = $1"},
+    // Counts a bad PIN atomically and starts the lockout on the last allowed
+    // attempt; returns no row if another session locked the account first.
+    {stmt::RecordFailedLogin,
+     "UPDATE accounts SET "
+     "failed_attempts = CASE WHEN failed_attempts + 1 >= $2 THEN 0 ELSE failed_attempts + 1 END, "
+     "locked_until = CASE WHEN failed_attempts + 1 >= $2 THEN $3 + $4 ELSE locked_until END "
+     "WHERE id = $1 AND locked_until <= $3 "
+     "RETURNING failed_attempts, locked_until"},
+    {stmt::ClearFailedLogins,
+     "UPDATE accounts SET failed_attempts = 0, locked_until = 0 WHERE id = $1"},
+    // Balance mutations apply the delta server-side, write the ledger row and
+    // return the new balance in one statement (data-modifying CTEs always run
+    // to completion, whether or not the final SELECT reads them).
+    {stmt::DepositFunds,
+     "WITH acc AS ("
+     "  UPDATE accounts SET balance = balance + $2::int8 * 0.01 WHERE id = $1 RETURNING id, balance"
+     "), ledger AS ("
+     "  INSERT INTO transactions (account_id, kind, amount, counterparty, note) "
+     "  SELECT id, " + kindSql(TransactionKind::Deposit) + ", $2::int8 * 0.01, '', '' FROM acc"
+     ") "
+     "SELECT (balance * 100)::int8 AS balance_cents FROM acc"},
+    {stmt::WithdrawFunds,
+     "WITH acc AS ("
+     "  UPDATE accounts SET balance = balance - $2::int8 * 0.01 "
+     "  WHERE id = $1 AND balance >= $2::int8 * 0.01 RETURNING id, balance"
+     "), ledger AS ("
+     "  INSERT INTO transactions (account_id, kind, amount, counterparty, note) "
+     "  SELECT id, " + kindSql(TransactionKind::Withdraw) + ", $2::int8 * 0.01, '', '' FROM acc"
+     ") "
+     "SELECT (balance * 100)::int8 AS balance_cents FROM acc"},
+    // The whole transfer in one round-trip. Both rows are locked in id order
+    // (NO KEY UPDATE still lets other sessions insert ledger rows that reference
+    // them), and the writes only happen when both exist and the balance covers
+    // the amount. has_from/has_to and a NULL balance tell the caller which
+    // check failed.
+    {stmt::TransferFunds,
+     "WITH locked AS ("
+     "  SELECT id, username, balance FROM accounts "
+     "  WHERE id = $1 OR (username = $2 AND id <> $1) ORDER BY id FOR NO KEY UPDATE"
+     "), src AS (SELECT id, username, balance FROM locked WHERE id = $1"
+     "), dst AS (SELECT id, username FROM locked WHERE id <> $1"
+     "), ok AS ("
+     "  SELECT src.id AS from_id, src.username AS from_name, dst.id AS to_id, dst.username AS to_name "
+     "  FROM src, dst WHERE src.balance >= $3::int8 * 0.01"
+     "), debit AS ("
+     "  UPDATE accounts a SET balance = a.balance - $3::int8 * 0.01 FROM ok WHERE a.id = ok.from_id RETURNING a.balance"
+     "), credit AS ("
+     "  UPDATE accounts a SET balance = a.balance + $3::int8 * 0.01 FROM ok WHERE a.id = ok.to_id"
+     "), ledger AS ("
+     "  INSERT INTO transactions (account_id, kind, amount, counterparty, note) "
+     "  SELECT from_id, " + kindSql(TransactionKind::TransferOut) + ", $3::int8 * 0.01, to_name, '' FROM ok "
+     "  UNION ALL SELECT to_id, " + kindSql(TransactionKind::TransferIn) + ", $3::int8 * 0.01, from_name, '' FROM ok"
+     ") "
+     "SELECT (SELECT count(*) FROM src)::int AS has_from, (SELECT count(*) FROM dst)::int AS has_to, "
+     "(SELECT (balance * 100)::int8 FROM debit) AS balance_cents, (SELECT id FROM dst) AS to_id"},
+    // The starting balance and its InitialDeposit ledger row commit together.
+    {stmt::CreateAccount,
+     "WITH created AS ("
+     "  INSERT INTO accounts (username, pin_hash, salt, balance) VALUES ($1, $2, $3, $4::int8 * 0.01) RETURNING id"
+     "), ledger AS ("
+     "  INSERT INTO transactions (account_id, kind, amount, counterparty, note) "
+     "  SELECT id, " + kindSql(TransactionKind::InitialDeposit) + ", $4::int8 * 0.01, '', '' FROM created WHERE $4::int8 > 0"
+     ") "
+     "SELECT id FROM created"},
+    // Arrays are passed as text literals, e.g. '{1,2}', '{t,f}'.
+    {stmt::LogLoginBatch,
+     "INSERT INTO login_logs (account_id, success, login_time) "
+     "SELECT a, s, to_timestamp(t / 1000000.0) "
+     "FROM unnest($1::int[], $2::bool[], $3::int8[]) AS u(a, s, t)"},
+    {stmt::RecordTransaction,
+     "INSERT INTO transactions (account_id, kind, amount, counterparty, note) VALUES ($1, $2::int2, $3::int8 * 0.01, $4, $5)"},
+    {stmt::HistoryOlder,
+     "SELECT id, kind, (amount * 100)::int8 AS amount_cents, counterparty, note, created_at::text AS created_at "
+     "FROM transactions WHERE account_id = $1 AND id < $2 ORDER BY id DESC LIMIT $3"},
+    {stmt::HistoryNewer,
+     "SELECT id, kind, (amount * 100)::int8 AS amount_cents, counterparty, note, created_at::text AS created_at "
+     "FROM transactions WHERE account_id = $1 AND id > $2 ORDER BY id ASC LIMIT $3"},
+    // Typed bounds on the partition key let the executor prune to the one
+    // monthly partition even for the generic plan of the prepared statement.
+    // Months are UTC months, as for partitions and monthly_totals.
+    {stmt::StatementItems,
+     "SELECT kind, (amount * 100)::int8 AS amount_cents, counterparty, note, created_at::text AS created_at "
+     "FROM transactions WHERE account_id = $1 "
+     "AND created_at >= ($2::timestamp AT TIME ZONE 'UTC') AND created_at < ($3::timestamp AT TIME ZONE 'UTC') "
+     "ORDER BY created_at ASC, id ASC"},
+    {stmt::MonthlyTotals,
+     "SELECT (total_in * 100)::int8 AS total_in_cents, (total_out * 100)::int8 AS total_out_cents, txn_count "
+     "FROM monthly_totals WHERE account_id = $1 AND month = $2::date"},
+    {stmt::AccountsInRange,
+     "SELECT id, (balance * 100)::int8 AS balance_cents FROM accounts WHERE id >= $1 AND id < $2 ORDER BY id"},
+    // Regenerating an archived month keeps the items stored before its ledger rows were dropped.
+    {stmt::UpsertStatement,
+     "INSERT INTO statements (account_id, statement_month, total_in, total_out, ending_balance, items_json) "
+     "VALUES ($1, $2, $3::int8 * 0.01, $4::int8 * 0.01, $5::int8 * 0.01, $6) "
+     "ON CONFLICT (account_id, statement_month) DO UPDATE SET "
+     "total_in = EXCLUDED.total_in, total_out = EXCLUDED.total_out, ending_balance = EXCLUDED.ending_balance, "
+     "items_json = CASE WHEN EXISTS (SELECT 1 FROM archived_partitions WHERE month = $2::date) "
+     "THEN statements.items_json ELSE EXCLUDED.items_json END, generated_at = NOW()"},
+    // Bulk username lookup for ingestion; $1 is a text array literal of quoted names.
+    {stmt::ResolveUsernames,
+     "SELECT id, username FROM accounts WHERE username = ANY($1::text[])"},
+    // Sent first in every ingestion batch: a batch that already committed
+    // fails here on the primary key instead of applying its rows twice.
+    {stmt::IngestCheckpoint,
+     "INSERT INTO ingest_batches (file_hash, first_line, line_count) VALUES ($1, $2, $3)"},
+    {stmt::IngestedRanges,
+     "SELECT first_line, line_count FROM ingest_batches WHERE file_hash = $1 ORDER BY first_line"},
+    {stmt::IngestedBatch,
+     "SELECT line_count FROM ingest_batches WHERE file_hash = $1 AND first_line = $2"},
+    // Balance against ledger for every account in [$1, $2). Archived months no
+    // longer have ledger rows, so their net comes from monthly_totals.
+    {stmt::ReconcileRange,
+     "SELECT a.id, a.username, (a.balance * 100)::int8 AS balance_cents, "
+     "((COALESCE(l.net, 0) + COALESCE(m.net, 0)) * 100)::int8 AS ledger_cents, COALESCE(l.n, 0) AS ledger_rows "
+     "FROM accounts a "
+     "LEFT JOIN (SELECT account_id, SUM(amount * transaction_direction(kind)) AS net, count(*) AS n "
+     "  FROM transactions WHERE account_id >= $1 AND account_id < $2 GROUP BY account_id) l ON l.account_id = a.id "
+     "LEFT JOIN (SELECT account_id, SUM(total_in - total_out) AS net FROM monthly_totals "
+     "  WHERE account_id >= $1 AND account_id < $2 AND month IN (SELECT month FROM archived_partitions) "
+     "  GROUP BY account_id) m ON m.account_id = a.id "
+     "WHERE a.id >= $1 AND a.id < $2 ORDER BY a.id"},
+};
+
+std::atomic<bool> preparedEnabled{true};
+
+} // namespace
+
+void prepareStatements(pqxx::connection& conn) {
+    for (const auto& def : kStatements) {
+        conn.prepare(def.name, def.sql);
+    }
+}
+
+const std::string& statementSql(const char* name) {
+    for (const auto& def : kStatements) {
+        if (std::strcmp(def.name, name) == 0) return def.sql;
+    }
+    throw std::out_of_range(std::string("Unknown statement: ") + name);
+}
+
+std::vector<const char*> statementNames() {
+    std::vector<const char*> names;
+    for (const auto& def : kStatements) {
+        names.push_back(def.name);
+    }
+    return names;
+}
+
+void setPreparedStatementsEnabled(bool enabled) {
+    preparedEnabled.store(enabled);
+}
+
+bool preparedStatementsEnabled() {
+    return preparedEnabled.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,52 @@
+#ifndef STATEMENTS_H
+#define STATEMENTS_H
+
+#include <pqxx/pqxx>
+#include <string>
+#include <utility>
+#include <vector>
+#include "metrics.h"
+
+// Names of the statements prepared on every pooled connection (SQL lives in statements.cpp).
+namespace stmt {
+const char* const FetchAccountByUsername = "fetch_account_by_username";
+const char* const FetchAccountById = "fetch_account_by_id";
+const char* const RecordFailedLogin = "record_failed_login";
+const char* const ClearFailedLogins = "clear_failed_logins";
+const char* const DepositFunds = "deposit_funds";
+const char* const WithdrawFunds = "withdraw_funds";
+const char* const TransferFunds = "transfer_funds";
+const char* const CreateAccount = "create_account";
+const char* const LogLoginBatch = "log_login_batch";
+const char* const RecordTransaction = "record_transaction";
+const char* const HistoryOlder = "history_older";
+const char* const HistoryNewer = "history_newer";
+const char* const StatementItems = "statement_items";
+const char* const MonthlyTotals = "monthly_totals";
+const char* const AccountsInRange = "accounts_in_range";
+const char* const UpsertStatement = "upsert_statement";
+const char* const ResolveUsernames = "resolve_usernames";
+const char* const IngestCheckpoint = "ingest_checkpoint";
+const char* const IngestedRanges = "ingested_ranges";
+const char* const IngestedBatch = "ingested_batch";
+const char* const ReconcileRange = "reconcile_range";
+}
+
+void prepareStatements(pqxx::connection& conn);
+const std::string& statementSql(const char* name);
+std::vector<const char*> statementNames();
+
+// When disabled, statements are sent as plain exec_params (used to benchmark the difference).
+void setPreparedStatementsEnabled(bool enabled);
+bool preparedStatementsEnabled();
+
+template <typename... Args>
+pqxx::result execStatement(pqxx::transaction_base& tx, const char* name, Args&&... args) {
+    DbTimer timer(name);
+    if (preparedStatementsEnabled()) {
+        return tx.exec_prepared(name, std::forward<Args>(args)...);
+    }
+    return tx.exec_params(statementSql(name), std::forward<Args>(args)...);
+}
+
+#endif // STATEMENTS_H
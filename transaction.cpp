@@ -1,175 +1,312 @@
 #include "transaction.h"
 #include "utils.h"
+#include "statements.h"
+#include "output_writer.h"
+#include <charconv>
+#include <chrono>
+#include <algorithm>
 #include <iostream>
-#include <fstream>
 #include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
 
-void recordTransaction(pqxx::work& tx, int account_id, const std::string& type, double amount, const std::string& counterparty, const std::string& note) {
-    tx.exec_params(
-        "INSERT INTO transactions (account_id, type, amount, counterparty, note) VALUES ($1, $2, $3, $4, $5)",
-        account_id, type, amount, counterparty, note
+TransactionKind parseTransactionKind(std::string_view text) {
+    long code = 0;
+    TransactionKind kind;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), code);
+    if (ec != std::errc() || end != text.data() + text.size() || !transactionKindFromCode(code, kind)) {
+        throw std::runtime_error("Unknown transaction kind " + std::string(text));
+    }
+    return kind;
+}
+
+void recordTransaction(pqxx::work& tx, int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note) {
+    execStatement(tx, stmt::RecordTransaction,
+        account_id, static_cast<int>(kind), amount.cents(), counterparty, note
     );
 }
 
-void showHistory(pqxx::connection& conn, int account_id) {
+HistoryPage fetchHistoryPage(pqxx::connection& conn, int account_id, long long anchor_id, HistoryDirection dir, int page_size) {
+    HistoryPage page;
     pqxx::work tx(conn);
-    pqxx::result res = tx.exec_params(
-        "SELECT type, amount, counterparty, note, created_at::text AS created_at "
-        "FROM transactions WHERE account_id = $1 ORDER BY id DESC",
-        account_id
-    );
 
-    if (res.empty()) {
+    // One extra row tells us whether another page exists in the same direction.
+    pqxx::result res;
+    if (dir == HistoryDirection::Older) {
+        long long before = anchor_id > 0 ? anchor_id : std::numeric_limits<long long>::max();
+        res = execStatement(tx, stmt::HistoryOlder, account_id, before, page_size + 1);
+    } else {
+        res = execStatement(tx, stmt::HistoryNewer, account_id, anchor_id, page_size + 1);
+    }
+    tx.commit();
+
+    bool more = res.size() > static_cast<size_t>(page_size);
+    size_t count = more ? static_cast<size_t>(page_size) : res.size();
+    page.entries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto& row = res[i];
+        HistoryEntry e;
+        e.id = row["id"].as<long long>();
+        e.kind = parseTransactionKind(row["kind"].view());
+        e.amount = Money::fromCents(row["amount_cents"].as<int64_t>());
+        e.counterparty = row["counterparty"].is_null() ? "" : row["counterparty"].c_str();
+        e.note = row["note"].is_null() ? "" : row["note"].c_str();
+        e.created_at = row["created_at"].c_str();
+        page.entries.push_back(std::move(e));
+    }
+
+    if (dir == HistoryDirection::Older) {
+        page.has_older = more;
+        page.has_newer = anchor_id > 0;
+    } else {
+        // Fetched oldest-first; pages are always shown newest-first.
+        std::reverse(page.entries.begin(), page.entries.end());
+        page.has_newer = more;
+        page.has_older = true;
+    }
+    return page;
+}
+
+void printHistoryPage(const HistoryPage& page) {
+    if (page.entries.empty()) {
         std::cout << "No transactions yet.\n";
         return;
     }
 
-    for (const auto& row : res) {
-        std::string type = row["type"].c_str();
-        std::string counterparty = row["counterparty"].is_null() ? "" : row["counterparty"].c_str();
-        std::string note = row["note"].is_null() ? "" : row["note"].c_str();
-        std::string created = row["created_at"].c_str();
-        double amount = row["amount"].as<double>();
-
-        std::cout << "- [" << created << "] " << type << " $" << formatMoney(amount);
-        if (!counterparty.empty()) std::cout << " (" << counterparty << ")";
-        if (!note.empty()) std::cout << " - " << note;
+    for (const auto& e : page.entries) {
+        std::cout << "- [" << e.created_at << "] " << transactionKindName(e.kind) << " $" << formatMoney(e.amount);
+        if (!e.counterparty.empty()) std::cout << " (" << e.counterparty << ")";
+        if (!e.note.empty()) std::cout << " - " << e.note;
         std::cout << "\n";
     }
 }
 
-void exportHistory(pqxx::connection& conn, const Account& acc) {
-    std::string csvName = "history_" + acc.username + ".csv";
-    std::string jsonName = "history_" + acc.username + ".json";
+namespace {
 
+struct ExportCounts {
+    long long rows = 0;
+    uint64_t bytes = 0;
+};
+
+// Writes both files from scratch, so a replica read that breaks off can be
+// redone on the primary.
+ExportCounts writeHistoryExport(pqxx::connection& conn, const Account& acc, const std::string& csvName, const std::string& jsonName) {
+    ExportCounts counts;
+    OutputWriter csv(csvName);
+    OutputWriter json(jsonName);
+    if (!csv.isOpen()) throw std::runtime_error("Could not open " + csvName + " for writing");
+    if (!json.isOpen()) throw std::runtime_error("Could not open " + jsonName + " for writing");
+
+    csv.write("index,created_at,type,amount,counterparty,note\n");
+    json.write("[\n");
+
+    // COPY cannot take bind parameters; the id is an integer and quoted by pqxx.
+    // NUMERIC(12,2)::text is already the two-decimal form formatMoney() produces.
+    // Ordering by the partition key lets Postgres read the monthly partitions
+    // one after another from (account_id, created_at, id) instead of merging them.
     pqxx::work tx(conn);
-    pqxx::result res = tx.exec_params(
-        "SELECT type, amount, counterparty, note, created_at::text AS created_at "
-        "FROM transactions WHERE account_id = $1 ORDER BY id ASC",
-        acc.id
-    );
+    auto stream = pqxx::stream_from::query(tx,
+        "SELECT created_at::text, kind, amount::text, counterparty, note "
+        "FROM transactions WHERE account_id = " + tx.quote(acc.id) + " ORDER BY created_at ASC, id ASC");
 
-    {
-        std::ofstream csv(csvName, std::ios::trunc);
-        csv << "index,created_at,type,amount,counterparty,note\n";
-        for (size_t i = 0; i < res.size(); ++i) {
-            std::string counterparty = res[i]["counterparty"].is_null() ? "" : res[i]["counterparty"].c_str();
-            std::string note = res[i]["note"].is_null() ? "" : res[i]["note"].c_str();
-            std::string cellNote = note;
-            std::string cellParty = counterparty;
-
-            size_t pos = 0;
-            while ((pos = cellNote.find('"', pos)) != std::string::npos) {
-                cellNote.insert(pos, "\"");
-                pos += 2;
-            }
-            pos = 0;
-            while ((pos = cellParty.find('"', pos)) != std::string::npos) {
-                cellParty.insert(pos, "\"");
-                pos += 2;
-            }
-
-            csv << (i + 1) << ",";
-            csv << '"' << res[i]["created_at"].c_str() << '"' << ",";
-            csv << '"' << res[i]["type"].c_str() << '"' << ",";
-            csv << res[i]["amount"].as<double>() << ",";
-            csv << '"' << cellParty << '"' << ",";
-            csv << '"' << cellNote << '"' << "\n";
-        }
-    }
+    long long index = 0;
+    while (const std::vector<pqxx::zview>* row = stream.read_row()) {
+        std::string_view created = (*row)[0];
+        std::string_view type = transactionKindName(parseTransactionKind((*row)[1]));
+        std::string_view amount = (*row)[2];
+        // NULL fields come back as views with no data.
+        std::string_view counterparty = (*row)[3].data() ? std::string_view((*row)[3]) : std::string_view();
+        std::string_view note = (*row)[4].data() ? std::string_view((*row)[4]) : std::string_view();
+        ++index;
+
+        csv.writeInt(index);
+        csv.put(',');
+        csv.writeCsvQuoted(created);
+        csv.put(',');
+        csv.writeCsvQuoted(type);
+        csv.put(',');
+        csv.write(amount);
+        csv.put(',');
+        csv.writeCsvQuoted(counterparty);
+        csv.put(',');
+        csv.writeCsvQuoted(note);
+        csv.put('\n');
 
-    {
-        std::ofstream json(jsonName, std::ios::trunc);
-        json << "[\n";
-        for (size_t i = 0; i < res.size(); ++i) {
-            std::string counterparty = res[i]["counterparty"].is_null() ? "" : res[i]["counterparty"].c_str();
-            std::string note = res[i]["note"].is_null() ? "" : res[i]["note"].c_str();
-            json << "  {\"index\": " << (i + 1)
-                 << ", \"created_at\": \"" << escapeJson(res[i]["created_at"].c_str()) << "\""
-                 << ", \"type\": \"" << escapeJson(res[i]["type"].c_str()) << "\""
-                 << ", \"amount\": " << res[i]["amount"].as<double>()
-                 << ", \"counterparty\": \"" << escapeJson(counterparty) << "\""
-                 << ", \"note\": \"" << escapeJson(note) << "\"";
-            json << "}";
-            if (i + 1 < res.size()) json << ",";
-            json << "\n";
-        }
-        json << "]\n";
+        if (index > 1) json.write(",\n");
+        json.write("  {\"index\": ");
+        json.writeInt(index);
+        json.write(", \"created_at\": \"");
+        json.writeJsonEscaped(created);
+        json.write("\", \"type\": \"");
+        json.writeJsonEscaped(type);
+        json.write("\", \"amount\": ");
+        json.write(amount);
+        json.write(", \"counterparty\": \"");
+        json.writeJsonEscaped(counterparty);
+        json.write("\", \"note\": \"");
+        json.writeJsonEscaped(note);
+        json.write("\"}");
     }
+    stream.complete();
+    tx.commit();
+
+    if (index > 0) json.put('\n');
+    json.write("]\n");
+    csv.flush();
+    json.flush();
+    if (!csv.good()) throw std::runtime_error("Write to " + csvName + " failed");
+    if (!json.good()) throw std::runtime_error("Write to " + jsonName + " failed");
 
-    std::cout << "Exported history to " << csvName << " and " << jsonName << ".\n";
+    counts.rows = index;
+    counts.bytes = csv.bytesWritten() + json.bytesWritten();
+    return counts;
 }
 
-void generateMonthlyStatement(pqxx::connection& conn, const Account& acc) {
-    std::string input = prompt("Statement month (YYYY-MM, Enter for current): ");
-    int year = 0;
-    int month = 0;
-
-    if (input.empty()) {
-        std::time_t t = std::time(nullptr);
-        std::tm local{};
-#if defined(_WIN32)
-        localtime_s(&local, &t);
-#else
-        local = *std::localtime(&t);
-#endif
-        year = local.tm_year + 1900;
-        month = local.tm_mon + 1;
-    } else if (!parseYearMonth(input, year, month)) {
-        std::cout << "Invalid month format. Use YYYY-MM.\n";
-        return;
-    }
+} // namespace
+
+void exportHistory(pqxx::connection& conn, const Account& acc, const ReadRoute& route, const std::string& directory) {
+    std::string base = directory.empty() ? std::string() : directory + "/";
+    std::string csvName = base + "history_" + acc.username + ".csv";
+    std::string jsonName = base + "history_" + acc.username + ".json";
+
+    auto started = std::chrono::steady_clock::now();
+    ExportCounts counts = routeRead(route, conn, [&](pqxx::connection& readConn) {
+        return writeHistoryExport(readConn, acc, csvName, jsonName);
+    });
 
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (seconds <= 0.0) seconds = 1e-9;
+
+    // Formatted locally: this runs on a job thread, and std::cout's flags are
+    // shared with the menu.
+    std::ostringstream report;
+    report << "Exported history to " << csvName << " and " << jsonName << ".\n";
+    report << counts.rows << " rows, " << counts.bytes << " bytes in " << std::fixed << std::setprecision(3) << seconds << " s ("
+           << std::setprecision(0) << counts.rows / seconds << " rows/s, "
+           << std::setprecision(2) << counts.bytes / seconds / (1024.0 * 1024.0) << " MiB/s).\n";
+    std::cout << report.str();
+}
+
+StatementContents readMonthlyStatement(pqxx::transaction_base& tx, int account_id, int year, int month) {
     std::string start = monthStartDate(year, month);
     std::string end = nextMonthStartDate(year, month);
 
-    pqxx::work tx(conn);
-    pqxx::result res = tx.exec_params(
-        "SELECT type, amount, counterparty, note, created_at::text AS created_at "
-        "FROM transactions WHERE account_id = $1 AND created_at >= $2 AND created_at < $3 "
-        "ORDER BY created_at ASC",
-        acc.id, start, end
+    pqxx::result res = execStatement(tx, stmt::StatementItems,
+        account_id, start, end
     );
 
-    double total_in = 0.0;
-    double total_out = 0.0;
+    // Totals come from the trigger-maintained rollup instead of classifying every row.
+    StatementContents contents;
+    pqxx::result totals = execStatement(tx, stmt::MonthlyTotals,
+        account_id, start
+    );
+    if (!totals.empty()) {
+        contents.total_in = Money::fromCents(totals[0]["total_in_cents"].as<int64_t>());
+        contents.total_out = Money::fromCents(totals[0]["total_out_cents"].as<int64_t>());
+    }
 
-    std::ostringstream items;
-    items << "[";
+    // Built in place: fields are escaped straight from the result buffers.
+    std::string& items = contents.items_json;
+    items.reserve(2 + res.size() * 128);
+    items.push_back('[');
     for (size_t i = 0; i < res.size(); ++i) {
-        std::string type = res[i]["type"].c_str();
-        double amt = res[i]["amount"].as<double>();
-        std::string counterparty = res[i]["counterparty"].is_null() ? "" : res[i]["counterparty"].c_str();
-        std::string note = res[i]["note"].is_null() ? "" : res[i]["note"].c_str();
-        std::string created = res[i]["created_at"].c_str();
-
-        bool is_in = (type == "Deposit" || type == "InitialDeposit" || type == "TransferIn");
-        bool is_out = (type == "Withdraw" || type == "TransferOut");
-        if (is_in) total_in += amt;
-        if (is_out) total_out += amt;
-
-        items << "{"
-              << "\"created_at\":\"" << escapeJson(created) << "\""
-              << ",\"type\":\"" << escapeJson(type) << "\""
-              << ",\"amount\":" << std::fixed << std::setprecision(2) << amt
-              << ",\"counterparty\":\"" << escapeJson(counterparty) << "\""
-              << ",\"note\":\"" << escapeJson(note) << "\"";
-        items << "}";
-        if (i + 1 < res.size()) items << ",";
+        const auto& row = res[i];
+        if (i > 0) items.push_back(',');
+        items.append("{\"created_at\":\"");
+        appendJsonEscaped(items, row["created_at"].view());
+        // Kind names never need escaping.
+        items.append("\",\"type\":\"");
+        items.append(transactionKindName(parseTransactionKind(row["kind"].view())));
+        items.append("\",\"amount\":");
+        appendMoney(items, Money::fromCents(row["amount_cents"].as<int64_t>()));
+        // NULL counterparty/note read as empty views.
+        items.append(",\"counterparty\":\"");
+        appendJsonEscaped(items, row["counterparty"].view());
+        items.append("\",\"note\":\"");
+        appendJsonEscaped(items, row["note"].view());
+        items.append("\"}");
     }
-    items << "]";
-
-    double ending_balance = acc.balance;
+    items.push_back(']');
+    return contents;
+}
 
-    tx.exec_params(
-        "INSERT INTO statements (account_id, statement_month, total_in, total_out, ending_balance, items_json) "
-        "VALUES ($1, $2, $3, $4, $5, $6) "
-        "ON CONFLICT (account_id, statement_month) DO UPDATE SET "
-        "total_in = EXCLUDED.total_in, total_out = EXCLUDED.total_out, ending_balance = EXCLUDED.ending_balance, items_json = EXCLUDED.items_json, generated_at = NOW()",
-        acc.id, start, total_in, total_out, ending_balance, items.str()
+void upsertMonthlyStatement(pqxx::work& tx, int account_id, Money ending_balance, int year, int month, const StatementContents& contents) {
+    execStatement(tx, stmt::UpsertStatement,
+        account_id, monthStartDate(year, month), contents.total_in.cents(), contents.total_out.cents(),
+        ending_balance.cents(), contents.items_json
     );
+}
+
+void storeMonthlyStatement(pqxx::work& tx, int account_id, Money ending_balance, int year, int month) {
+    upsertMonthlyStatement(tx, account_id, ending_balance, year, month, readMonthlyStatement(tx, account_id, year, month));
+}
+
+void generateMonthlyStatement(pqxx::connection& conn, const Account& acc, int year, int month, const ReadRoute& route) {
+    if (!route.router) {
+        pqxx::work tx(conn);
+        storeMonthlyStatement(tx, acc.id, acc.balance, year, month);
+        tx.commit();
+    } else {
+        StatementContents contents = routeRead(route, conn, [&](pqxx::connection& readConn) {
+            pqxx::read_transaction tx(readConn);
+            return readMonthlyStatement(tx, acc.id, year, month);
+        });
+        pqxx::work tx(conn);
+        upsertMonthlyStatement(tx, acc.id, acc.balance, year, month, contents);
+        tx.commit();
+    }
+
+    std::cout << "Statement stored for " << monthStartDate(year, month).substr(0, 7) << ".\n";
+}
+
+size_t verifyMonthlyTotals(pqxx::connection& conn, bool fix) {
+    const char* ledgerTotals =
+        "SELECT account_id, date_trunc('month', created_at AT TIME ZONE 'UTC')::date AS month, "
+        "COALESCE(SUM(amount) FILTER (WHERE transaction_direction(kind) = 1), 0) AS total_in, "
+        "COALESCE(SUM(amount) FILTER (WHERE transaction_direction(kind) = -1), 0) AS total_out, "
+        "COUNT(*)::int AS txn_count "
+        "FROM transactions GROUP BY 1, 2";
+
+    pqxx::work tx(conn);
+    if (fix) {
+        // Hold off new ledger rows (and their trigger updates) while rebuilding.
+        tx.exec("LOCK TABLE transactions IN SHARE MODE");
+    }
+
+    // One statement, one snapshot: rows and their trigger updates are always seen together.
+    pqxx::result drift = tx.exec(
+        std::string("WITH ledger AS (") + ledgerTotals + ") "
+        "SELECT COALESCE(l.account_id, m.account_id) AS account_id, "
+        "to_char(COALESCE(l.month, m.month), 'YYYY-MM') AS month, "
+        "(COALESCE(l.total_in, 0) * 100)::int8 AS ledger_in, (COALESCE(m.total_in, 0) * 100)::int8 AS rollup_in, "
+        "(COALESCE(l.total_out, 0) * 100)::int8 AS ledger_out, (COALESCE(m.total_out, 0) * 100)::int8 AS rollup_out, "
+        "COALESCE(l.txn_count, 0) AS ledger_count, COALESCE(m.txn_count, 0) AS rollup_count "
+        "FROM ledger l FULL OUTER JOIN monthly_totals m ON m.account_id = l.account_id AND m.month = l.month "
+        "WHERE (l.total_in IS DISTINCT FROM m.total_in OR l.total_out IS DISTINCT FROM m.total_out "
+        "OR l.txn_count IS DISTINCT FROM m.txn_count) "
+        // Archived months keep their rollups after their ledger rows are gone.
+        "AND COALESCE(l.month, m.month) NOT IN (SELECT month FROM archived_partitions) "
+        "ORDER BY 1, 2");
+
+    for (const auto& row : drift) {
+        std::cout << "account " << row["account_id"].as<int>() << " " << row["month"].c_str()
+                  << ": in " << formatMoney(Money::fromCents(row["rollup_in"].as<int64_t>()))
+                  << " (ledger " << formatMoney(Money::fromCents(row["ledger_in"].as<int64_t>())) << ")"
+                  << ", out " << formatMoney(Money::fromCents(row["rollup_out"].as<int64_t>()))
+                  << " (ledger " << formatMoney(Money::fromCents(row["ledger_out"].as<int64_t>())) << ")"
+                  << ", count " << row["rollup_count"].as<int>()
+                  << " (ledger " << row["ledger_count"].as<int>() << ")\n";
+    }
 
+    if (fix && !drift.empty()) {
+        tx.exec("DELETE FROM monthly_totals WHERE month NOT IN (SELECT month FROM archived_partitions)");
+        tx.exec(std::string("INSERT INTO monthly_totals (account_id, month, total_in, total_out, txn_count) ") + ledgerTotals);
+    }
     tx.commit();
 
-    std::cout << "Statement stored for " << start.substr(0, 7) << ".\n";
-}
\ No newline at end of file
+    std::cout << drift.size() << " drifted account-month(s)";
+    if (fix && !drift.empty()) std::cout << "; monthly_totals rebuilt from the ledger";
+    std::cout << ".\n";
+    return drift.size();
+}
@@ -1,13 +1,134 @@
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <pqxx/pqxx>
 #include "account.h"
+#include "replica.h"
 
-void recordTransaction(pqxx::work& tx, int account_id, const std::string& type, double amount, const std::string& counterparty, const std::string& note);
-void showHistory(pqxx::connection& conn, int account_id);
-void exportHistory(pqxx::connection& conn, const Account& acc);
-void generateMonthlyStatement(pqxx::connection& conn, const Account& acc);
+const int kHistoryPageSize = 10;
+
+// What a ledger row records. Stored as transactions.kind (SMALLINT); the
+// values are the ids of the transaction_kinds table (migration 6) and must
+// never be renumbered.
+enum class TransactionKind : int16_t {
+    Deposit = 1,
+    Withdraw = 2,
+    TransferIn = 3,
+    TransferOut = 4,
+    FakeTransfer = 5,
+    InitialDeposit = 6,
+};
+
+struct TransactionKindTraits {
+    const char* name;     // also the transaction_kinds name, and what exports and statements print
+    bool inflow;
+    bool outflow;
+    bool simulated;       // recorded without moving money
+};
+
+// Indexed by kind; entry 0 stands for any value outside the enum.
+constexpr TransactionKindTraits kTransactionKindTraits[] = {
+    {"Unknown", false, false, false},
+    {"Deposit", true, false, false},
+    {"Withdraw", false, true, false},
+    {"TransferIn", true, false, false},
+    {"TransferOut", false, true, false},
+    {"FakeTransfer", false, false, true},
+    {"InitialDeposit", true, false, false},
+};
+
+constexpr const TransactionKindTraits& transactionKindTraits(TransactionKind kind) {
+    int code = static_cast<int>(kind);
+    return kTransactionKindTraits[code >= 1 && code <= static_cast<int>(TransactionKind::InitialDeposit) ? code : 0];
+}
+
+static_assert(sizeof kTransactionKindTraits / sizeof kTransactionKindTraits[0] ==
+              static_cast<size_t>(TransactionKind::InitialDeposit) + 1,
+              "one traits entry per TransactionKind, plus Unknown");
+
+// 1 = money in, -1 = money out, 0 = neither. The transaction_kinds table and
+// transaction_direction() in SQL restate this; migrateSchema() refuses to
+// start when they disagree with these traits.
+constexpr int transactionDirection(TransactionKind kind) {
+    return transactionKindTraits(kind).inflow ? 1 : transactionKindTraits(kind).outflow ? -1 : 0;
+}
+
+inline const char* transactionKindName(TransactionKind kind) {
+    return transactionKindTraits(kind).name;
+}
+
+// False for codes and names that are not a TransactionKind. Inline so the
+// local ledger and bench use them without linking transaction.cpp (pqxx).
+inline bool transactionKindFromCode(long code, TransactionKind& out) {
+    if (code < 1 || code > static_cast<long>(TransactionKind::InitialDeposit)) return false;
+    out = static_cast<TransactionKind>(code);
+    return true;
+}
+
+inline bool transactionKindFromName(std::string_view name, TransactionKind& out) {
+    for (long code = 1; code <= static_cast<long>(TransactionKind::InitialDeposit); ++code) {
+        if (name == kTransactionKindTraits[code].name) {
+            out = static_cast<TransactionKind>(code);
+            return true;
+        }
+    }
+    return false;
+}
+
+// A transactions.kind column as text; throws on anything that is not a
+// TransactionKind, since the column has no constraint of its own.
+TransactionKind parseTransactionKind(std::string_view text);
+
+struct HistoryEntry {
+    long long id = 0;
+    TransactionKind kind = TransactionKind::Deposit;
+    Money amount;
+    std::string counterparty;
+    std::string note;
+    std::string created_at;
+};
+
+// One page of history, newest first. Pages are keyset cursors on (account_id, id):
+// the next page is anchored on the oldest id shown, the previous on the newest.
+struct HistoryPage {
+    std::vector<HistoryEntry> entries;
+    bool has_older = false;
+    bool has_newer = false;
+};
+
+enum class HistoryDirection { Older, Newer };
+
+void recordTransaction(pqxx::work& tx, int account_id, TransactionKind kind, Money amount, const std::string& counterparty, const std::string& note);
+// anchor_id of 0 with HistoryDirection::Older fetches the newest page.
+HistoryPage fetchHistoryPage(pqxx::connection& conn, int account_id, long long anchor_id, HistoryDirection dir, int page_size = kHistoryPageSize);
+void printHistoryPage(const HistoryPage& page);
+// Streams the history from a replica when route allows it (see ReadRoute).
+// Files go to directory, or the working directory when it is empty; throws
+// when they cannot be opened or written, so a queued export ends failed.
+void exportHistory(pqxx::connection& conn, const Account& acc, const ReadRoute& route = ReadRoute(),
+                   const std::string& directory = std::string());
+
+struct StatementContents {
+    Money total_in;
+    Money total_out;
+    std::string items_json;
+};
+
+// The read half of a statement: items and rollup totals for year-month.
+StatementContents readMonthlyStatement(pqxx::transaction_base& tx, int account_id, int year, int month);
+void upsertMonthlyStatement(pqxx::work& tx, int account_id, Money ending_balance, int year, int month, const StatementContents& contents);
+// Builds one account's statement for year-month and upserts it inside tx.
+void storeMonthlyStatement(pqxx::work& tx, int account_id, Money ending_balance, int year, int month);
+// With a replica route the contents are read there in their own transaction;
+// the statement itself is always written through conn.
+void generateMonthlyStatement(pqxx::connection& conn, const Account& acc, int year, int month, const ReadRoute& route = ReadRoute());
+// Recomputes monthly_totals from the raw ledger and prints every account-month
+// that differs; with fix, rebuilds the table. Archived months are left alone.
+// Returns the number of drifted rows.
+size_t verifyMonthlyTotals(pqxx::connection& conn, bool fix);
 
 #endif // TRANSACTION_H
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "transfer.h"
+#include "account_cache.h"
+#include "statements.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+const int kMaxAttempts = 5;
+const int kBaseBackoffMs = 2;
+const int kMaxBackoffMs = 100;
+
+std::atomic<uint64_t> committed{0};
+std::atomic<uint64_t> retries{0};
+std::atomic<uint64_t> aborted{0};
+std::atomic<uint64_t> insufficientFunds{0};
+std::atomic<uint64_t> recipientNotFound{0};
+
+int backoffMs(int attempt) {
+    thread_local std::mt19937 gen(std::random_device{}());
+    int cap = std::min(kMaxBackoffMs, kBaseBackoffMs << attempt);
+    std::uniform_int_distribution<int> dist(cap / 2, cap);
+    return dist(gen);
+}
+
+bool isRetryable(const std::string& sqlstate) {
+    return sqlstate == "40P01" || sqlstate == "40001";   // deadlock_detected, serialization_failure
+}
+
+TransferStatus classify(bool has_from, bool has_to, bool applied) {
+    if (!has_from) throw std::runtime_error("Account not found");
+    if (!has_to) return TransferStatus::RecipientNotFound;
+    if (!applied) return TransferStatus::InsufficientFunds;
+    return TransferStatus::Ok;
+}
+
+void count(TransferStatus status) {
+    if (status == TransferStatus::Ok) committed.fetch_add(1, std::memory_order_relaxed);
+    if (status == TransferStatus::InsufficientFunds) insufficientFunds.fetch_add(1, std::memory_order_relaxed);
+    if (status == TransferStatus::RecipientNotFound) recipientNotFound.fetch_add(1, std::memory_order_relaxed);
+}
+
+// One autocommit statement: locks, checks and applies (see stmt::TransferFunds).
+TransferStatus attemptTransfer(pqxx::connection& conn, int from_id, const std::string& to_username, Money amount, Money& new_balance) {
+    pqxx::nontransaction tx(conn);
+    pqxx::result res = execStatement(tx, stmt::TransferFunds,
+        from_id, to_username, amount.cents()
+    );
+    const auto& row = res[0];
+    bool applied = !row["balance_cents"].is_null();
+    TransferStatus status = classify(row["has_from"].as<int>() > 0, row["has_to"].as<int>() > 0, applied);
+    if (applied) {
+        accountCache().invalidate(from_id);
+        accountCache().invalidate(row["to_id"].as<int>());
+        new_balance = Money::fromCents(row["balance_cents"].as<int64_t>());
+    }
+    return status;
+}
+
+struct PendingTransfer {
+    AsyncExecutor* exec;
+    int from_id;
+    std::vector<AsyncStatement> statements;
+    TransferCallback done;
+    int attempt = 0;
+};
+
+void submitTransfer(std::shared_ptr<PendingTransfer> t, std::chrono::milliseconds delay) {
+    t->exec->submit(t->statements, [t](AsyncBatchResult r) {
+        AsyncTransferResult out;
+        if (!r.ok && isRetryable(r.sqlstate)) {
+            retries.fetch_add(1, std::memory_order_relaxed);
+            if (++t->attempt < kMaxAttempts) {
+                submitTransfer(t, std::chrono::milliseconds(backoffMs(t->attempt - 1)));
+                return;
+            }
+            aborted.fetch_add(1, std::memory_order_relaxed);
+            t->done(out);
+            return;
+        }
+        if (!r.ok || r.results.empty() || r.results[0].rows.empty()) {
+            out.error = r.error.empty() ? "transfer returned no result" : r.error;
+            t->done(out);
+            return;
+        }
+
+        const auto& row = r.results[0].rows[0];
+        bool applied = row.size() > 2 && row[2].has_value();
+        try {
+            out.status = classify(row[0] && *row[0] != "0", row[1] && *row[1] != "0", applied);
+            if (applied) {
+                accountCache().invalidate(t->from_id);
+                if (row.size() > 3 && row[3]) accountCache().invalidate(std::stoi(*row[3]));
+                out.new_balance = Money::fromCents(std::stoll(*row[2]));
+            }
+            count(out.status);
+        } catch (const std::exception& ex) {
+            out.status = TransferStatus::Aborted;
+            out.error = ex.what();
+        }
+        t->done(out);
+    }, delay);
+}
+
+} // namespace
+
+TransferStatus transferFunds(pqxx::connection& conn, int from_id, const std::string& to_username, Money amount, Money& new_balance) {
+    for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+        try {
+            TransferStatus status = attemptTransfer(conn, from_id, to_username, amount, new_balance);
+            count(status);
+            return status;
+        } catch (const pqxx::transaction_rollback&) {
+            // deadlock_detected / serialization_failure: the statement rolled back as a whole.
+            retries.fetch_add(1, std::memory_order_relaxed);
+            if (attempt + 1 < kMaxAttempts) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs(attempt)));
+            }
+        }
+    }
+    aborted.fetch_add(1, std::memory_order_relaxed);
+    return TransferStatus::Aborted;
+}
+
+void transferFundsAsync(AsyncExecutor& exec, int from_id, const std::string& to_username, Money amount, TransferCallback done) {
+    auto t = std::make_shared<PendingTransfer>();
+    t->exec = &exec;
+    t->from_id = from_id;
+    t->statements.push_back(AsyncStatement{stmt::TransferFunds,
+        {std::to_string(from_id), to_username, std::to_string(amount.cents())}});
+    t->done = std::move(done);
+    submitTransfer(t, std::chrono::milliseconds(0));
+}
+
+TransferStats transferStats() {
+    TransferStats s;
+    s.committed = committed.load();
+    s.retries = retries.load();
+    s.aborted = aborted.load();
+    s.insufficient_funds = insufficientFunds.load();
+    s.recipient_not_found = recipientNotFound.load();
+    return s;
+}
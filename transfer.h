@@ -0,0 +1,39 @@
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <pqxx/pqxx>
+#include "async_executor.h"
+#include "money.h"
+
+enum class TransferStatus { Ok, RecipientNotFound, InsufficientFunds, Aborted };
+
+struct TransferStats {
+    uint64_t committed = 0;
+    uint64_t retries = 0;             // attempts rolled back by a deadlock/serialization failure
+    uint64_t aborted = 0;             // transfers that ran out of retries
+    uint64_t insufficient_funds = 0;
+    uint64_t recipient_not_found = 0;
+};
+
+struct AsyncTransferResult {
+    TransferStatus status = TransferStatus::Aborted;
+    Money new_balance;
+    std::string error;                // set when the transfer failed for another reason (lost connection, unknown sender)
+};
+
+using TransferCallback = std::function<void(const AsyncTransferResult&)>;
+
+// Moves money between two accounts in a single statement: both rows are locked
+// in ascending id order, so two opposite-direction transfers queue behind each
+// other instead of deadlocking, and the balance check and both writes happen
+// under those locks. Transient rollbacks are retried with bounded, jittered backoff.
+TransferStatus transferFunds(pqxx::connection& conn, int from_id, const std::string& to_username, Money amount, Money& new_balance);
+// The same transfer on the async executor: the caller does not wait, retries
+// are scheduled on the executor, and done runs on its driver thread.
+void transferFundsAsync(AsyncExecutor& exec, int from_id, const std::string& to_username, Money amount, TransferCallback done);
+TransferStats transferStats();
+
+#endif // TRANSFER_H
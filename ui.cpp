@@ -1,11 +1,58 @@
 #include "ui.h"
 #include "utils.h"
 #include "account.h"
+#include "account_cache.h"
 #include "transaction.h"
+#include "transfer.h"
+#include "statements.h"
+#include "metrics.h"
+#include "ledger.h"
+#include <chrono>
+#include <functional>
 #include <iostream>
-#include <thread>
+#include <vector>
 
-void accountMenu(pqxx::connection& conn, Account& acc) {
+namespace {
+bool showTiming = false;
+
+void printElapsed(std::chrono::steady_clock::time_point start, const char* backend) {
+    if (!showTiming) return;
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "(" << backend << ", " << us / 1000.0 << " ms)\n";
+}
+
+void printNeonOnly() {
+    std::cout << "Only available with the Neon-backed ledger.\n";
+}
+}
+
+void setShowOperationTiming(bool enabled) {
+    showTiming = enabled;
+}
+
+static void showJobs(const JobScheduler& jobs, const std::vector<uint64_t>& mine) {
+    if (mine.empty()) {
+        std::cout << "No background jobs this session.\n";
+    }
+    for (uint64_t id : mine) {
+        JobStatus st;
+        if (!jobs.status(id, st)) continue;
+        std::cout << "- #" << st.id << " " << st.name << ": " << jobStateName(st.state);
+        if (st.state == JobState::Succeeded || st.state == JobState::Failed) {
+            std::cout << " in " << st.run_ms << " ms";
+        }
+        if (!st.error.empty()) std::cout << " (" << st.error << ")";
+        std::cout << "\n";
+    }
+
+    JobSchedulerStats stats = jobs.stats();
+    std::cout << "Queue: " << stats.queue_depth << " waiting, " << stats.running << "/" << stats.workers
+              << " workers busy; avg latency " << stats.avg_latency_ms << " ms, max " << stats.max_latency_ms << " ms\n";
+}
+
+void accountMenu(Ledger& ledger, JobScheduler* jobs, Account& acc, ReadSession* reads) {
+    const char* backend = !jobs ? "local" : preparedStatementsEnabled() ? "prepared" : "unprepared";
+    std::vector<uint64_t> myJobs;
     while (true) {
         std::cout << "\nLogged in as: " << acc.username << "\n";
         std::cout << "Balance: $" << formatMoney(acc.balance) << "\n";
@@ -16,129 +63,232 @@ void accountMenu(pqxx::connection& conn, Account& acc) {
         std::cout << "5. View History\n";
         std::cout << "6. Export History (CSV/JSON)\n";
         std::cout << "7. Generate Monthly Statement (store in Neon)\n";
-        std::cout << "8. Logout\n";
+        std::cout << "8. Background Jobs\n";
+        std::cout << "9. Logout\n";
 
         std::string choice = prompt("Select an option: ");
         if (choice == "1") {
-            double amt = 0.0;
+            Money amt;
             std::string in = prompt("Deposit amount: ");
             if (!parseAmount(in, amt)) {
                 std::cout << RED << "Invalid amount." << RESET << std::endl;
                 continue;
             }
 
-            pqxx::work tx(conn);
-            acc.balance += amt;
-            tx.exec_params("UPDATE accounts SET balance = $1 WHERE id = $2", acc.balance, acc.id);
-            recordTransaction(tx, acc.id, "Deposit", amt, "", "");
-            tx.commit();
+            ActionTimer action("menu.deposit");
+            auto opStart = std::chrono::steady_clock::now();
+            ledger.deposit(acc.id, amt, acc.balance);
 
             std::cout << GREEN << "Deposit complete." << RESET << std::endl;
+            printElapsed(opStart, backend);
         } else if (choice == "2") {
-            double amt = 0.0;
+            Money amt;
             std::string in = prompt("Withdraw amount: ");
             if (!parseAmount(in, amt)) {
                 std::cout << RED << "Invalid amount." << RESET << std::endl;
                 continue;
             }
-            if (amt > acc.balance) {
+
+            ActionTimer action("menu.withdraw");
+            auto opStart = std::chrono::steady_clock::now();
+            if (!ledger.withdraw(acc.id, amt, acc.balance)) {
                 std::cout << RED << "Insufficient funds." << RESET << std::endl;
                 continue;
             }
 
-            pqxx::work tx(conn);
-            acc.balance -= amt;
-            tx.exec_params("UPDATE accounts SET balance = $1 WHERE id = $2", acc.balance, acc.id);
-            recordTransaction(tx, acc.id, "Withdraw", amt, "", "");
-            tx.commit();
-
             std::cout << GREEN << "Withdrawal complete." << RESET << std::endl;
+            printElapsed(opStart, backend);
         } else if (choice == "3") {
             std::string toUser = prompt("Recipient username: ");
             if (toUser == acc.username) {
                 std::cout << "Cannot transfer to yourself. Use a different account.\n";
                 continue;
             }
-
-            Account recipient;
-            if (!fetchAccountByUsername(conn, toUser, recipient)) {
+            if (!isValidUsername(toUser)) {
                 std::cout << "Recipient not found.\n";
                 continue;
             }
 
-            double amt = 0.0;
+            Money amt;
             std::string in = prompt("Transfer amount: ");
             if (!parseAmount(in, amt)) {
                 std::cout << RED << "Invalid amount." << RESET << std::endl;
                 continue;
             }
-            if (amt > acc.balance) {
+
+            ActionTimer action("menu.transfer");
+            auto opStart = std::chrono::steady_clock::now();
+            TransferStatus status = ledger.transfer(acc.id, toUser, amt, acc.balance);
+            if (status == TransferStatus::RecipientNotFound) {
+                std::cout << "Recipient not found.\n";
+                continue;
+            }
+            if (status == TransferStatus::InsufficientFunds) {
                 std::cout << RED << "Insufficient funds." << RESET << std::endl;
                 continue;
             }
-
-            pqxx::work tx(conn);
-            acc.balance -= amt;
-            double recipient_balance = recipient.balance + amt;
-
-            tx.exec_params("UPDATE accounts SET balance = $1 WHERE id = $2", acc.balance, acc.id);
-            tx.exec_params("UPDATE accounts SET balance = $1 WHERE id = $2", recipient_balance, recipient.id);
-
-            recordTransaction(tx, acc.id, "TransferOut", amt, recipient.username, "");
-            recordTransaction(tx, recipient.id, "TransferIn", amt, acc.username, "");
-            tx.commit();
+            if (status == TransferStatus::Aborted) {
+                std::cout << RED << "Transfer could not complete due to contention. Please try again." << RESET << std::endl;
+                continue;
+            }
 
             std::cout << GREEN << "Transfer complete." << RESET << std::endl;
+            printElapsed(opStart, backend);
         } else if (choice == "4") {
             std::string toUser = prompt("Recipient username (simulated): ");
-            double amt = 0.0;
+            Money amt;
             std::string in = prompt("Transfer amount (simulated): ");
             if (!parseAmount(in, amt)) {
                 std::cout << RED << "Invalid amount." << RESET << std::endl;
                 continue;
             }
 
-            pqxx::work tx(conn);
-            recordTransaction(tx, acc.id, "FakeTransfer", amt, toUser, "simulated only, no balance moved");
-            tx.commit();
+            ActionTimer action("menu.fake_transfer");
+            ledger.recordEntry(acc.id, TransactionKind::FakeTransfer, amt, toUser, "simulated only, no balance moved");
 
             std::cout << GREEN << "Fake transfer recorded. No balances were moved." << RESET << std::endl;
         } else if (choice == "5") {
-            showHistory(conn, acc.id);
+            HistoryPage page;
+            {
+                ActionTimer action("menu.history_page");
+                page = ledger.historyPage(acc.id, 0, HistoryDirection::Older);
+            }
+            while (true) {
+                printHistoryPage(page);
+                if (!page.has_older && !page.has_newer) break;
+
+                std::string nav = prompt(std::string(page.has_older ? "[n] older  " : "") +
+                                         (page.has_newer ? "[p] newer  " : "") + "[Enter] back: ");
+                if (nav == "n" && page.has_older) {
+                    ActionTimer action("menu.history_page");
+                    page = ledger.historyPage(acc.id, page.entries.back().id, HistoryDirection::Older);
+                } else if (nav == "p" && page.has_newer) {
+                    ActionTimer action("menu.history_page");
+                    page = ledger.historyPage(acc.id, page.entries.front().id, HistoryDirection::Newer);
+                    if (page.entries.size() < static_cast<size_t>(kHistoryPageSize)) {
+                        // Ran into the newest rows: show a full first page instead of a short one.
+                        page = ledger.historyPage(acc.id, 0, HistoryDirection::Older);
+                    }
+                } else {
+                    break;
+                }
+            }
         } else if (choice == "6") {
-            std::cout << YELLOW << "Exporting history..." << RESET << std::endl;
-            beep();
-            std::thread exportThread([conn, acc]() {
-                exportHistory(conn, acc);
+            if (!jobs) {
+                printNeonOnly();
+                continue;
+            }
+            // The route is taken now, so the export sees every write made before it was queued.
+            ReadRoute route = reads ? reads->route() : ReadRoute();
+            uint64_t id = jobs->trySubmit("export " + acc.username, [acc, route](pqxx::connection& jobConn) {
+                ActionTimer action("job.export_history");
+                exportHistory(jobConn, acc, route);
                 beep(1000, 300); // success beep
             });
-            exportThread.detach();
-            std::cout << GREEN << "Export started in background." << RESET << std::endl;
-        } else if (choice == "7") {
-            std::cout << YELLOW << "Generating statement..." << RESET << std::endl;
+            if (id == 0) {
+                std::cout << RED << "Background queue is full. Try again shortly." << RESET << std::endl;
+                continue;
+            }
+            myJobs.push_back(id);
             beep();
-            std::thread stmtThread([conn, acc]() {
-                generateMonthlyStatement(conn, acc);
+            std::cout << GREEN << "Export queued as job #" << id << "." << RESET << std::endl;
+        } else if (choice == "7") {
+            if (!jobs) {
+                printNeonOnly();
+                continue;
+            }
+            // Ask here: the background thread must not read stdin.
+            std::string input = prompt("Statement month (YYYY-MM, Enter for current): ");
+            int year = 0;
+            int month = 0;
+            if (input.empty()) {
+                currentYearMonth(year, month);
+            } else if (!parseYearMonth(input, year, month)) {
+                std::cout << "Invalid month format. Use YYYY-MM.\n";
+                continue;
+            }
+
+            ReadRoute route = reads ? reads->route() : ReadRoute();
+            uint64_t id = jobs->trySubmit("statement " + monthStartDate(year, month).substr(0, 7), [acc, year, month, route](pqxx::connection& jobConn) {
+                ActionTimer action("job.monthly_statement");
+                generateMonthlyStatement(jobConn, acc, year, month, route);
                 beep(1200, 300); // success beep
             });
-            stmtThread.detach();
-            std::cout << GREEN << "Statement generation started in background." << RESET << std::endl;
+            if (id == 0) {
+                std::cout << RED << "Background queue is full. Try again shortly." << RESET << std::endl;
+                continue;
+            }
+            myJobs.push_back(id);
+            beep();
+            std::cout << GREEN << "Statement generation queued as job #" << id << "." << RESET << std::endl;
         } else if (choice == "8") {
+            if (!jobs) {
+                printNeonOnly();
+                continue;
+            }
+            showJobs(*jobs, myJobs);
+        } else if (choice == "9") {
             std::cout << "Logged out.\n";
             return;
         } else {
             std::cout << "Invalid option.\n";
         }
+    }
+}
 
-        Account refreshed;
-        if (fetchAccountById(conn, acc.id, refreshed)) {
-            acc = refreshed;
-        }
+// Hidden "admin" option: latency metrics plus the state of every shared component.
+static void showAdminStats(const Database& db, const ReadRouter* replica, const LoginLogWriter& loginLog, const JobScheduler& jobs) {
+    std::cout << "\n" << metricsText();
+
+    PoolStats pool = db.poolStats();
+    std::cout << "\nPool: " << pool.idle << "/" << pool.size << " idle, " << pool.acquisitions << " acquisitions, "
+              << pool.waits << " waited (max " << pool.max_wait_us / 1000.0 << " ms), "
+              << pool.health_checks << " health checks, " << pool.reconnects << " reconnects\n";
+
+    if (replica) {
+        ReadRouterStats rs = replica->stats();
+        PoolStats rp = replica->poolStats();
+        std::cout << "Read replica: " << rs.replica_reads << " reads, fell back " << rs.behind_fallbacks
+                  << " behind own writes / " << rs.lag_fallbacks << " lagging / " << rs.error_fallbacks << " errors; "
+                  << rs.checks << " checks, lag " << rs.lag_ms << " ms; pool " << rp.idle << "/" << rp.size << " idle\n";
     }
+
+    TransferStats transfers = transferStats();
+    std::cout << "Transfers: " << transfers.committed << " committed, " << transfers.retries << " retries, "
+              << transfers.aborted << " aborted, " << transfers.insufficient_funds << " insufficient funds, "
+              << transfers.recipient_not_found << " unknown recipient\n";
+
+    AccountCacheStats cache = accountCache().stats();
+    std::cout << "Account cache: " << cache.size << "/" << cache.capacity << " cached, " << cache.hits << " hits, "
+              << cache.misses << " misses, " << cache.evictions << " evictions, " << cache.invalidations
+              << " invalidations (" << cache.notifications << " notified), " << cache.stale_puts << " stale reads dropped\n";
+
+    LoginLogStats logins = loginLog.stats();
+    std::cout << "Login log: " << logins.recorded << " recorded, " << logins.written << " written in "
+              << logins.batches << " batches, " << logins.dropped << " dropped\n";
+
+    JobSchedulerStats js = jobs.stats();
+    std::cout << "Jobs: " << js.succeeded << " succeeded, " << js.failed << " failed, " << js.rejected << " rejected; "
+              << js.queue_depth << " waiting, " << js.running << "/" << js.workers << " workers busy; avg latency "
+              << js.avg_latency_ms << " ms, max " << js.max_latency_ms << " ms\n";
 }
 
-void mainMenu(pqxx::connection& conn) {
-    std::cout << "=== CLI Bank App (Neon-backed) ===\n";
+// Local ledger counterpart of the admin view: metrics plus engine and journal state.
+static void showLocalStats(const LocalLedger& ledger) {
+    std::cout << "\n" << metricsText();
+
+    LocalLedgerStats st = ledger.stats();
+    std::cout << "\nLedger: " << st.accounts << " accounts, " << st.entries << " entries, " << st.replayed
+              << " records replayed at open, " << st.snapshots << " snapshots\n";
+    std::cout << "Journal: generation " << st.journal.generation << ", " << st.journal.bytes << " bytes, "
+              << st.journal.records << " records appended, " << st.journal.syncs << " syncs covering "
+              << st.journal.synced_records << " records\n";
+}
+
+// The create/login loop shared by both backends. loginLog, jobs and reads are
+// null for the local ledger.
+static void ledgerMenu(Ledger& ledger, LoginLogWriter* loginLog, JobScheduler* jobs, ReadSession* reads, const std::function<void()>& showAdmin) {
+    std::cout << "=== CLI Bank App (" << ledger.name() << ") ===\n";
 
     while (true) {
         std::cout << "\n1. Create Account\n";
@@ -154,7 +304,7 @@ void mainMenu(pqxx::connection& conn) {
             }
 
             Account existing;
-            if (fetchAccountByUsername(conn, username, existing)) {
+            if (ledger.fetchAccountByUsername(username, existing)) {
                 std::cout << "Username already exists.\n";
                 continue;
             }
@@ -168,20 +318,21 @@ void mainMenu(pqxx::connection& conn) {
             std::string salt = generateSalt();
             std::string pin_hash = hashPin(pin, salt);
 
-            double initial_balance = 0.0;
+            Money initial_balance;
             std::string initial = prompt("Initial deposit (optional, press Enter to skip): ");
             if (!initial.empty()) {
                 if (!parseAmount(initial, initial_balance)) {
                     std::cout << "Invalid amount; starting with $0.00.\n";
-                    initial_balance = 0.0;
+                    initial_balance = Money();
                 }
             }
 
-            int new_id = createAccount(conn, username, pin_hash, salt, initial_balance);
-            if (initial_balance > 0.0) {
-                pqxx::work tx(conn);
-                recordTransaction(tx, new_id, "InitialDeposit", initial_balance, "", "");
-                tx.commit();
+            {
+                ActionTimer action("menu.create_account");
+                if (ledger.createAccount(username, pin_hash, salt, initial_balance) == 0) {
+                    std::cout << "Username already exists.\n";
+                    continue;
+                }
             }
 
             std::cout << "Account created. You can now log in.\n";
@@ -189,46 +340,51 @@ void mainMenu(pqxx::connection& conn) {
             std::string username = prompt("Username: ");
             std::string pin = prompt("PIN: ");
 
-            Account acc;
-            if (!fetchAccountByUsername(conn, username, acc)) {
+            LoginResult login;
+            {
+                ActionTimer action("menu.login");
+                login = ledger.authenticate(username, pin, nowSeconds());
+                if (loginLog && login.status != LoginStatus::UnknownUser) {
+                    loginLog->record(login.account.id, login.status == LoginStatus::Ok);
+                }
+            }
+
+            if (login.status == LoginStatus::UnknownUser) {
                 std::cout << "Invalid login.\n";
                 continue;
             }
-
-            long long now = nowSeconds();
-            if (acc.locked_until > now) {
-                long long remaining = acc.locked_until - now;
-                std::cout << "Account locked. Try again in " << remaining << " seconds.\n";
-                logLogin(conn, acc.id, false);
+            if (login.status == LoginStatus::Locked) {
+                std::cout << "Account locked. Try again in " << login.lock_remaining << " seconds.\n";
                 continue;
             }
-
-            std::string expected = hashPin(pin, acc.salt);
-            if (acc.pin_hash != expected) {
-                acc.failed_attempts += 1;
-                if (acc.failed_attempts >= 3) {  // kMaxFailedAttempts
-                    acc.locked_until = now + 60;  // kLockSeconds
-                    acc.failed_attempts = 0;
-                    std::cout << "Too many failed attempts. Account locked for 60 seconds.\n";
-                } else {
-                    int remaining = 3 - acc.failed_attempts;
-                    std::cout << "Invalid login. Attempts left: " << remaining << ".\n";
-                }
-                updateAccountAuth(conn, acc);
-                logLogin(conn, acc.id, false);
+            if (login.status == LoginStatus::LockedOut) {
+                std::cout << "Too many failed attempts. Account locked for " << kLockSeconds << " seconds.\n";
+                continue;
+            }
+            if (login.status == LoginStatus::BadPin) {
+                std::cout << "Invalid login. Attempts left: " << login.attempts_left << ".\n";
                 continue;
             }
 
-            acc.failed_attempts = 0;
-            acc.locked_until = 0;
-            updateAccountAuth(conn, acc);
-            logLogin(conn, acc.id, true);
-            accountMenu(conn, acc);
+            accountMenu(ledger, jobs, login.account, reads);
         } else if (choice == "3") {
             std::cout << "Goodbye.\n";
             break;
+        } else if (choice == "admin") {
+            showAdmin();
         } else {
             std::cout << "Invalid option.\n";
         }
     }
+}
+
+void mainMenu(Database& db, LoginLogWriter& loginLog, JobScheduler& jobs, ReadRouter* replica) {
+    Database::Lease session = db.acquire();
+    ReadSession reads(replica, *session);
+    PostgresLedger ledger(*session, &reads);
+    ledgerMenu(ledger, &loginLog, &jobs, &reads, [&] { showAdminStats(db, replica, loginLog, jobs); });
+}
+
+void localMenu(LocalLedger& ledger) {
+    ledgerMenu(ledger, nullptr, nullptr, nullptr, [&] { showLocalStats(ledger); });
 }
\ No newline at end of file
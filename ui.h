@@ -3,8 +3,22 @@
 
 #include <pqxx/pqxx>
 #include "account.h"
+#include "database.h"
+#include "job_scheduler.h"
+#include "ledger.h"
+#include "local_ledger.h"
+#include "login_log.h"
+#include "replica.h"
 
-void accountMenu(pqxx::connection& conn, Account& acc);
-void mainMenu(pqxx::connection& conn);
+// Print round-trip time after deposit/withdraw/transfer (benchmarking aid).
+void setShowOperationTiming(bool enabled);
+// jobs is null for ledgers without Postgres; exports, statements and the job
+// list are then unavailable. With reads, exports and statements read from the
+// replica as of the session's latest write.
+void accountMenu(Ledger& ledger, JobScheduler* jobs, Account& acc, ReadSession* reads = nullptr);
+// replica, when set, serves the session's history, export and statement reads.
+void mainMenu(Database& db, LoginLogWriter& loginLog, JobScheduler& jobs, ReadRouter* replica = nullptr);
+// The same menus on an embedded ledger; no login log or background jobs.
+void localMenu(LocalLedger& ledger);
 
 #endif // UI_H
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "utils.h"
+#include "output_writer.h"
 #include <iostream>
 #include <algorithm>
 #include <ctime>
@@ -17,23 +18,18 @@ std::string prompt(const std::string& label) {
     return trim(line);
 }
 
-bool parseAmount(const std::string& s, double& out) {
-    try {
-        size_t idx = 0;
-        double v = std::stod(s, &idx);
-        if (idx != s.size()) return false;
-        if (v <= 0.0) return false;
-        out = v;
-        return true;
-    } catch (...) {
-        return false;
-    }
+bool parseAmount(const std::string& s, Money& out) {
+    Money v;
+    if (!parseMoney(s, v)) return false;
+    if (!v.isPositive()) return false;
+    out = v;
+    return true;
 }
 
-std::string formatMoney(double v) {
-    std::ostringstream oss;
-    oss << std::fixed << std::setprecision(2) << v;
-    return oss.str();
+std::string formatMoney(Money v) {
+    std::string out;
+    appendMoney(out, v);
+    return out;
 }
 
 long long nowSeconds() {
@@ -42,21 +38,8 @@ long long nowSeconds() {
 
 std::string escapeJson(const std::string& s) {
     std::string out;
-    out.reserve(s.size());
-    for (char c : s) {
-        if (c == '\\' || c == '"') {
-            out.push_back('\\');
-            out.push_back(c);
-        } else if (c == '\n') {
-            out += "\\n";
-        } else if (c == '\r') {
-            out += "\\r";
-        } else if (c == '\t') {
-            out += "\\t";
-        } else {
-            out.push_back(c);
-        }
-    }
+    out.reserve(s.size() + s.size() / 8 + 2);
+    appendJsonEscaped(out, s);
     return out;
 }
 
@@ -71,6 +54,18 @@ bool parseYearMonth(const std::string& input, int& year, int& month) {
     return year >= 1970 && month >= 1 && month <= 12;
 }
 
+void currentYearMonth(int& year, int& month) {
+    std::time_t t = std::time(nullptr);
+    std::tm local{};
+#if defined(_WIN32)
+    localtime_s(&local, &t);
+#else
+    local = *std::localtime(&t);
+#endif
+    year = local.tm_year + 1900;
+    month = local.tm_mon + 1;
+}
+
 std::string monthStartDate(int year, int month) {
     std::ostringstream oss;
     oss << std::setw(4) << std::setfill('0') << year << "-";
@@ -78,8 +73,6 @@ std::string monthStartDate(int year, int month) {
     return oss.str();
 }
 
-#include <windows.h> // for Beep
-
 std::string nextMonthStartDate(int year, int month) {
     int y = year;
     int m = month + 1;
@@ -90,6 +83,14 @@ std::string nextMonthStartDate(int year, int month) {
     return monthStartDate(y, m);
 }
 
+#if defined(_WIN32)
+#include <windows.h> // for Beep
+
 void beep(int frequency, int duration) {
     Beep(frequency, duration);
-}
\ No newline at end of file
+}
+#else
+void beep(int, int) {
+    std::cout << '\a' << std::flush;
+}
+#endif
\ No newline at end of file
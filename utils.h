@@ -4,14 +4,16 @@
 #include <string>
 #include <iomanip>
 #include <sstream>
+#include "money.h"
 
 std::string trim(const std::string& s);
 std::string prompt(const std::string& label);
-bool parseAmount(const std::string& s, double& out);
-std::string formatMoney(double v);
+bool parseAmount(const std::string& s, Money& out);
+std::string formatMoney(Money v);
 long long nowSeconds();
 std::string escapeJson(const std::string& s);
 bool parseYearMonth(const std::string& input, int& year, int& month);
+void currentYearMonth(int& year, int& month);
 std::string monthStartDate(int year, int month);
 std::string nextMonthStartDate(int year, int month);
 